@@ -0,0 +1,30 @@
+#include <fuzzing/datasource/id.hpp>
+#include <fuzzing/datasource/writer.hpp>
+#include <stdio.h>
+
+/* Writes a JsonTester seed that parses and re-serializes a JSON document:
+ *
+ * ./writer '{"a": [1, 2.5, "x"]}' > seed
+ */
+
+using fuzzing::datasource::ID;
+
+int main(int argc, char** argv)
+{
+    if ( argc != 2 ) {
+        fprintf(stderr, "Usage: %s <json>\n", argv[0]);
+        return 1;
+    }
+
+    fuzzing::datasource::DatasourceWriter writer;
+
+    /* JsonTester::op_StringConversion is the first of 12 operations */
+    writer.PutIndex(12, 0, ID("JsonTester.Multitest"));
+    writer.Put<std::string>(argv[1], ID("content-type:json"));
+    writer.Put<bool>(true, ID("JsonTester.op_StringConversion.Get<bool> (method choice)"));
+
+    const auto seed = writer.Get();
+    fwrite(seed.data(), seed.size(), 1, stdout);
+
+    return 0;
+}
@@ -1,163 +1,740 @@
 #pragma once
 
+#include <fuzzing/datasource/trace.hpp>
 #include <fuzzing/exception.hpp>
 #include <fuzzing/types.hpp>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <memory_resource>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace fuzzing {
 namespace datasource  {
 
-class Base
+/* Non-owning view of a range of the input */
+template <class T>
+class Span {
+    private:
+        const T* _data = nullptr;
+        size_t _size = 0;
+    public:
+        Span(void) = default;
+        Span(const T* data, const size_t size) : _data(data), _size(size) { }
+
+        const T* data(void) const { return _data; }
+        size_t size(void) const { return _size; }
+        bool empty(void) const { return _size == 0; }
+        const T* begin(void) const { return _data; }
+        const T* end(void) const { return _data + _size; }
+        const T& operator[](const size_t i) const { return _data[i]; }
+};
+
+class OutOfData : public fuzzing::exception::FlowException {
+    public:
+        OutOfData() = default;
+};
+
+class DeserializationFailure : public fuzzing::exception::FlowException {
+    public:
+        DeserializationFailure() = default;
+};
+
+/* Input format
+ *
+ * By default every read consumes a 32-bit length prefix (host byte order)
+ * followed by that many bytes. The length is clamped to the [min, max]
+ * range of the read, so Get<uint16_t> consumes 4 + 2 bytes.
+ *
+ * With FormatRawScalars, Get<T> for fixed-size T (and Get<bool>) reads
+ * sizeof(T) bytes without a length prefix. Variable-length reads are
+ * unaffected.
+ *
+ * With FormatPartitioned (Datasource only), the input is a sequence of
+ * records:
+ *
+ *   uint64_t id;
+ *   uint32_t size; (length prefix)
+ *   uint8_t data[size];
+ *
+ * Each record holds the sub-stream for reads tagged with that id, encoded
+ * as above. If an id occurs more than once, only its first record is
+ * used. Since the reads for one id cannot shift the reads for another, a
+ * mutation in one sub-stream leaves the decoding of the others intact.
+ *
+ * Records end at the first one that claims more bytes than are left. The
+ * bytes from there on, the remainder, form one more sub-stream, which
+ * serves the reads for all ids without a record. So an input that is not
+ * partitioned at all is usually read like an unpartitioned input. Not
+ * always: if its first bytes happen to form a record header (an 8-byte
+ * id followed by a length that fits in the rest), they are split off as
+ * records.
+ *
+ * With FormatVarintLength, every length prefix (including the size of a
+ * FormatPartitioned record) is an unsigned LEB128 varint of 1 to 5 bytes
+ * instead of a fixed uint32_t. The fifth byte always terminates the
+ * varint. Padded encodings such as 0x80 0x00 for 0 are accepted.
+ *
+ * With FormatBulkVectors, GetVector<T> for trivially copyable T reads a
+ * single length-prefixed array of elements instead of a Get<bool>
+ * continuation flag before every element. Trailing bytes that do not
+ * form a whole element are ignored. Vectors of other types are unaffected.
+ *
+ * Inputs written for one format decode differently under another, so a
+ * corpus should stick to one.
+ */
+enum Format : uint32_t {
+    FormatDefault = 0,
+    FormatRawScalars = 1 << 0,
+    FormatPartitioned = 1 << 1,
+    FormatBulkVectors = 1 << 2,
+    FormatVarintLength = 1 << 3,
+};
+
+/* Results of the typed accessors can be allocated from an arena owned by
+ * the datasource (see Datasource::EnableArena) by requesting these types.
+ */
+using ArenaString = std::pmr::string;
+template <class T> using ArenaVector = std::pmr::vector<T>;
+
+/* Read position in an in-memory input */
+struct Cursor {
+    const uint8_t* data;
+    size_t idx;
+    size_t left;
+};
+
+/* Decodes the input format from an in-memory buffer */
+class Decoder {
+    private:
+        Cursor cursor;
+        const uint32_t format;
+
+        Span<uint8_t> consume(const size_t size) {
+            if ( cursor.left < size ) {
+                throw OutOfData();
+            }
+
+            const Span<uint8_t> ret(cursor.data + cursor.idx, size);
+            cursor.idx += size;
+            cursor.left -= size;
+
+            return ret;
+        }
+    public:
+        static const size_t kMaxLengthSize = 5;
+
+        Decoder(const uint8_t* data, const size_t size, const uint32_t format) :
+            cursor{data, 0, size}, format(format)
+        { }
+
+        /* Decodes the length prefix at data. Returns the number of bytes
+         * it occupies, or 0 if the input ends before it does.
+         */
+        static size_t DecodeLength(const uint8_t* data, const size_t left, const uint32_t format, uint32_t& length) {
+            if ( !(format & FormatVarintLength) ) {
+                if ( left < sizeof(length) ) {
+                    return 0;
+                }
+                memcpy(&length, data, sizeof(length));
+                return sizeof(length);
+            }
+
+            uint64_t v = 0;
+            for (size_t i = 0; i < kMaxLengthSize && i < left; i++) {
+                v |= static_cast<uint64_t>(data[i] & 0x7F) << (i * 7);
+                if ( !(data[i] & 0x80) || i + 1 == kMaxLengthSize ) {
+                    length = v > UINT32_MAX ? UINT32_MAX : v;
+                    return i + 1;
+                }
+            }
+
+            return 0;
+        }
+
+        /* Writes the length prefix for length to out, which must have room
+         * for kMaxLengthSize bytes. Returns the number of bytes written.
+         */
+        static size_t EncodeLength(uint8_t* out, uint32_t length, const uint32_t format) {
+            if ( !(format & FormatVarintLength) ) {
+                memcpy(out, &length, sizeof(length));
+                return sizeof(length);
+            }
+
+            size_t i = 0;
+            while ( true ) {
+                out[i] = length & 0x7F;
+                length >>= 7;
+                i++;
+                if ( length == 0 ) {
+                    break;
+                }
+                out[i - 1] |= 0x80;
+            }
+
+            return i;
+        }
+
+        Span<uint8_t> Get(const size_t min, const size_t max) {
+            uint32_t getSize;
+            const size_t prefixSize = DecodeLength(cursor.data + cursor.idx, cursor.left, format, getSize);
+            if ( prefixSize == 0 ) {
+                throw OutOfData();
+            }
+            consume(prefixSize);
+
+            if ( getSize < min ) {
+                getSize = min;
+            }
+            if ( max && getSize > max ) {
+                getSize = max;
+            }
+
+            return consume(getSize);
+        }
+
+        Span<uint8_t> GetScalar(const size_t size) {
+            if ( format & FormatRawScalars ) {
+                return consume(size);
+            }
+
+            return Get(size, size);
+        }
+
+        uint32_t GetFormat(void) const {
+            return format;
+        }
+
+        Cursor& GetCursor(void) {
+            return cursor;
+        }
+};
+
+/* Number of input bytes GetRange() reads per attempt for hi - lo == range.
+ * The bytes form a little-endian integer, except for range == UINT64_MAX,
+ * where they form a uint64_t in host byte order.
+ */
+inline size_t RangeNumBytes(const uint64_t range) {
+    size_t numBytes = 1;
+    while ( numBytes < sizeof(uint64_t) && (range >> (numBytes * 8)) != 0 ) {
+        numBytes++;
+    }
+    return numBytes;
+}
+
+/* Typed accessors, shared by the virtual (Base) and the statically
+ * dispatched (StaticDatasource) datasources.
+ *
+ * Derived must provide:
+ *
+ *   Span<uint8_t> getSpan(const size_t min, const size_t max, const uint64_t id);
+ *   void readScalar(void* dest, const size_t size, const uint64_t id);
+ *   uint32_t getFormat(void) const;
+ *   std::pmr::memory_resource* getMemoryResource(void) const;
+ */
+template <class Derived>
+class StaticBase {
+    private:
+        Derived& derived(void) {
+            return static_cast<Derived&>(*this);
+        }
+
+        template <class T, class Vector> Vector getVector(const uint64_t id, Vector ret) {
+            if constexpr ( std::is_trivially_copyable<T>::value ) {
+                if ( derived().getFormat() & FormatBulkVectors ) {
+                    const auto data = derived().getSpan(0, 0, id);
+
+                    if constexpr ( std::is_same<T, bool>::value ) {
+                        ret.resize(data.size());
+                        for (size_t i = 0; i < data.size(); i++) {
+                            ret[i] = data[i] % 2;
+                        }
+                    } else if constexpr ( sizeof(T) == 1 ) {
+                        ret.assign(data.begin(), data.end());
+                    } else {
+                        ret.resize(data.size() / sizeof(T));
+                        if ( !ret.empty() ) {
+                            memcpy(ret.data(), data.data(), ret.size() * sizeof(T));
+                        }
+                    }
+
+                    return ret;
+                }
+            }
+
+            while ( Get<bool>(id) == true ) {
+                /* Through Derived, which may specialize Get<T> */
+                ret.push_back( derived().template Get<T>(id) );
+            }
+
+            return ret;
+        }
+    public:
+        using OutOfData = datasource::OutOfData;
+        using DeserializationFailure = datasource::DeserializationFailure;
+
+        template <class T> T Get(const uint64_t id = 0) {
+            if constexpr ( std::is_same<T, bool>::value ) {
+                uint8_t ret;
+                derived().readScalar(&ret, sizeof(ret), id);
+                return (ret % 2) ? true : false;
+            } else if constexpr ( std::is_same<T, std::string>::value ) {
+                return std::string(GetStringView(id));
+            } else if constexpr ( std::is_same<T, std::vector<std::string>>::value ) {
+                std::vector<std::string> ret;
+                while ( true ) {
+                    ret.emplace_back( GetStringView(id) );
+                    if ( Get<bool>(id) == false ) {
+                        break;
+                    }
+                }
+                return ret;
+            } else if constexpr ( std::is_same<T, ArenaString>::value ) {
+                return ArenaString(GetStringView(id), derived().getMemoryResource());
+            } else if constexpr ( std::is_same<T, ArenaVector<ArenaString>>::value ) {
+                ArenaVector<ArenaString> ret(derived().getMemoryResource());
+                while ( true ) {
+                    ret.emplace_back( GetStringView(id) );
+                    if ( Get<bool>(id) == false ) {
+                        break;
+                    }
+                }
+                return ret;
+            } else if constexpr ( std::is_same<T, types::String<>>::value || std::is_same<T, types::Data<>>::value ) {
+                const auto data = derived().getSpan(0, 0, id);
+                /* Containers copy shallowly, so the result must be
+                 * constructed in place; a named local is not elided here.
+                 */
+                return T(data.data(), data.size());
+            } else {
+                T ret;
+                derived().readScalar(&ret, sizeof(ret), id);
+                return ret;
+            }
+        }
+
+        uint16_t GetChoice(const uint64_t id = 0) {
+            return Get<uint16_t>(id);
+        }
+
+        /* Returns a uniformly distributed value in [lo, hi].
+         *
+         * Consumes only as many bytes as are needed to represent hi - lo
+         * (none if lo == hi). Values that would bias the result are
+         * rejected, and another value is read.
+         */
+        uint64_t GetRange(const uint64_t lo, const uint64_t hi, const uint64_t id = 0) {
+            if ( lo >= hi ) {
+                return lo;
+            }
+
+            const uint64_t range = hi - lo;
+
+            const size_t numBytes = RangeNumBytes(range);
+
+            if ( range == UINT64_MAX ) {
+                uint64_t v;
+                derived().readScalar(&v, sizeof(v), id);
+                return v;
+            }
+
+            /* Largest multiple of the number of values that fits in numBytes */
+            const uint64_t count = range + 1;
+            const uint64_t numValues = numBytes == sizeof(uint64_t) ? 0 : (1ULL << (numBytes * 8));
+            const uint64_t limit = numValues == 0 ?
+                UINT64_MAX - (UINT64_MAX % count + 1) % count :
+                numValues - (numValues % count);
+
+            while ( true ) {
+                uint8_t bytes[sizeof(uint64_t)];
+                derived().readScalar(bytes, numBytes, id);
+
+                uint64_t v = 0;
+                for (size_t i = 0; i < numBytes; i++) {
+                    v |= static_cast<uint64_t>(bytes[i]) << (i * 8);
+                }
+
+                if ( numValues == 0 ? v <= limit : v < limit ) {
+                    return lo + (v % count);
+                }
+            }
+        }
+
+        /* Returns a uniformly distributed value in [0, n). Unlike
+         * GetChoice(), which returns a raw 16-bit value.
+         */
+        size_t GetIndex(const size_t n, const uint64_t id = 0) {
+            if ( n == 0 ) {
+                throw exception::LogicException("GetIndex: no choices");
+            }
+
+            return GetRange(0, n - 1, id);
+        }
+
+        std::vector<uint8_t> GetData(const uint64_t id, const size_t min = 0, const size_t max = 0) {
+            const auto data = derived().getSpan(min, max, id);
+            return std::vector<uint8_t>(data.begin(), data.end());
+        }
+
+        Span<uint8_t> GetSpan(const uint64_t id, const size_t min = 0, const size_t max = 0) {
+            return derived().getSpan(min, max, id);
+        }
+
+        std::string_view GetStringView(const uint64_t id = 0) {
+            const auto data = derived().getSpan(0, 0, id);
+            return std::string_view(reinterpret_cast<const char*>(data.data()), data.size());
+        }
+
+        template <class T> std::vector<T> GetVector(const uint64_t id = 0) {
+            return getVector<T>(id, std::vector<T>());
+        }
+
+        template <class T> ArenaVector<T> GetArenaVector(const uint64_t id = 0) {
+            return getVector<T>(id, ArenaVector<T>(derived().getMemoryResource()));
+        }
+};
+
+class Base : public StaticBase<Base>
 {
+    friend class StaticBase<Base>;
+    private:
+        /* Backing storage for the default getSpan() */
+        std::vector<uint8_t> spanBuffer;
     protected:
+        /* If an implementation sets this, fixed-size scalars are read
+         * inline from the cursor without a length prefix, bypassing
+         * getScalar().
+         */
+        Cursor* scalarCursor = nullptr;
+
+        /* Format flags that affect the typed accessors */
+        uint32_t format = FormatDefault;
+        uint32_t getFormat(void) const {
+            return format;
+        }
+
+        /* Allocates ArenaString and ArenaVector results */
+        std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource();
+        std::pmr::memory_resource* getMemoryResource(void) const {
+            return memoryResource;
+        }
+
         virtual std::vector<uint8_t> get(const size_t min, const size_t max, const uint64_t id = 0) = 0;
+
+        /* Implementations that hold the entire input in memory should override
+         * this and return a view into it. The default implementation
+         * wraps get(), in which case the view is only valid until the next read.
+         */
+        virtual Span<uint8_t> getSpan(const size_t min, const size_t max, const uint64_t id = 0);
+
+        /* Returns exactly 'size' bytes for a fixed-size scalar */
+        virtual Span<uint8_t> getScalar(const size_t size, const uint64_t id = 0);
+
+        void readScalar(void* dest, const size_t size, const uint64_t id) {
+            if ( scalarCursor != nullptr ) {
+                if ( scalarCursor->left < size ) {
+                    throw OutOfData();
+                }
+                memcpy(dest, scalarCursor->data + scalarCursor->idx, size);
+                scalarCursor->idx += size;
+                scalarCursor->left -= size;
+                return;
+            }
+
+            const auto v = getScalar(size, id);
+            memcpy(dest, v.data(), size);
+        }
     public:
         Base(void) = default;
         virtual ~Base(void) = default;
 
-        template<class T> T Get(const uint64_t id = 0);
-        uint16_t GetChoice(const uint64_t id = 0);
-        std::vector<uint8_t> GetData(const uint64_t id, const size_t min = 0, const size_t max = 0);
-        template <class T> std::vector<T> GetVector(const uint64_t id = 0);
-
-        class OutOfData : public fuzzing::exception::FlowException {
-            public:
-                OutOfData() = default;
-        };
-
-        class DeserializationFailure : public fuzzing::exception::FlowException {
-            public:
-                DeserializationFailure() = default;
-        };
+        /* Can be specialized for further types, as in
+         *
+         *   template <> Foo fuzzing::datasource::Base::Get<Foo>(const uint64_t id) { ... }
+         *
+         * which GetVector<Foo> then uses as well.
+         */
+        template <class T> T Get(const uint64_t id = 0) {
+            return StaticBase<Base>::Get<T>(id);
+        }
 };
 
 #ifndef FUZZING_HEADERS_NO_IMPL
-template<class T> T Base::Get(const uint64_t id)
+Span<uint8_t> Base::getSpan(const size_t min, const size_t max, const uint64_t id)
 {
-    T ret;
-    const auto v = get(sizeof(ret), sizeof(ret), id);
-    memcpy(&ret, v.data(), sizeof(ret));
-    return ret;
+    spanBuffer = get(min, max, id);
+    return Span<uint8_t>(spanBuffer.data(), spanBuffer.size());
 }
 
-template <> bool Base::Get<bool>(const uint64_t id)
+Span<uint8_t> Base::getScalar(const size_t size, const uint64_t id)
 {
-    uint8_t ret;
-    const auto v = get(sizeof(ret), sizeof(ret), id);
-    memcpy(&ret, v.data(), sizeof(ret));
-    return (ret % 2) ? true : false;
+    return getSpan(size, size, id);
 }
+#endif
 
-template <> std::string Base::Get<std::string>(const uint64_t id)
+class Datasource : public Base
 {
-    auto data = GetData(id);
-    return std::string(data.data(), data.data() + data.size());
-}
+    private:
+        Decoder decoder;
+
+        /* FormatPartitioned: one decoder per id, and one for the ids
+         * without a record
+         */
+        std::vector<std::pair<uint64_t, Decoder>> partitions;
+        std::optional<Decoder> remainder;
+        size_t lastPartition = 0;
+        Decoder& getPartition(const uint64_t id);
+        Decoder& getDecoder(const uint64_t id) {
+            if ( !(decoder.GetFormat() & FormatPartitioned) ) {
+                return decoder;
+            }
+
+            return getPartition(id);
+        }
+
+        Trace* trace = nullptr;
+
+        std::optional<std::pmr::monotonic_buffer_resource> arena;
 
-template <> std::vector<std::string> Base::Get<std::vector<std::string>>(const uint64_t id)
+        Span<uint8_t> getSpanTraced(Decoder& d, const size_t min, const size_t max, const uint64_t id);
+        Span<uint8_t> getScalarTraced(Decoder& d, const size_t size, const uint64_t id);
+        void record(Decoder& d, const size_t start, const uint64_t id, const size_t min, const size_t max, const size_t dataSize, const uint32_t flags = 0);
+        void setScalarCursor(void);
+
+        std::vector<uint8_t> get(const size_t min, const size_t max, const uint64_t id = 0) override;
+        Span<uint8_t> getSpan(const size_t min, const size_t max, const uint64_t id = 0) override;
+        Span<uint8_t> getScalar(const size_t size, const uint64_t id = 0) override;
+    public:
+        /* Spans and string views returned by this class point into _data
+         * and remain valid for as long as _data does.
+         */
+        Datasource(const uint8_t* _data, const size_t _size, const uint32_t _format = FormatDefault);
+        Datasource(const Datasource& other);
+
+        /* Record every read into trace, or stop recording if nullptr.
+         * The trace must outlive this object or be detached first.
+         */
+        void SetTrace(Trace* trace);
+
+        /* Allocate ArenaString and ArenaVector results from a monotonic
+         * arena owned by this object. The memory is released all at once
+         * when this object is destroyed, so results must not outlive it.
+         * Copies of this object allocate from the same arena.
+         *
+         * The arena starts out with 'buffer', if given, and falls back
+         * to the heap for anything that does not fit.
+         */
+        void EnableArena(const size_t initialSize = 4096);
+        void EnableArena(void* buffer, const size_t size);
+};
+
+#ifndef FUZZING_HEADERS_NO_IMPL
+Datasource::Datasource(const uint8_t* _data, const size_t _size, const uint32_t _format) :
+    Base(), decoder(_data, _size, _format)
 {
-    std::vector<std::string> ret;
-    while ( true ) {
-        auto data = GetData(id);
-        ret.push_back( std::string(data.data(), data.data() + data.size()) );
-        if ( Get<bool>(id) == false ) {
-            break;
+    format = _format;
+
+    if ( decoder.GetFormat() & FormatPartitioned ) {
+        /* Split the input into per-id sub-streams */
+        const uint8_t* data = _data;
+        size_t left = _size;
+
+        while ( left > sizeof(uint64_t) ) {
+            uint64_t id;
+            uint32_t size;
+
+            memcpy(&id, data, sizeof(id));
+
+            const size_t prefixSize = Decoder::DecodeLength(data + sizeof(id), left - sizeof(id), _format, size);
+            if ( prefixSize == 0 || size > left - sizeof(id) - prefixSize ) {
+                break;
+            }
+            data += sizeof(id) + prefixSize;
+            left -= sizeof(id) + prefixSize;
+
+            bool duplicate = false;
+            for (const auto& partition : partitions) {
+                if ( partition.first == id ) {
+                    duplicate = true;
+                    break;
+                }
+            }
+
+            if ( duplicate == false ) {
+                partitions.emplace_back(id, Decoder(data, size, _format));
+            }
+
+            data += size;
+            left -= size;
         }
+
+        remainder.emplace(data, left, _format);
     }
-    return ret;
-}
 
-uint16_t Base::GetChoice(const uint64_t id)
-{
-    return Get<uint16_t>(id);
+    setScalarCursor();
 }
 
-std::vector<uint8_t> Base::GetData(const uint64_t id, const size_t min, const size_t max)
+Datasource::Datasource(const Datasource& other) :
+    Base(other), decoder(other.decoder), partitions(other.partitions), remainder(other.remainder), lastPartition(other.lastPartition), trace(other.trace)
 {
-    return get(min, max, id);
+    /* Must point to our own cursor, not other's */
+    setScalarCursor();
 }
 
-
-template <> types::String<> Base::Get<types::String<>>(const uint64_t id) {
-    const auto data = GetData(id);
-    types::String<> ret(data.data(), data.size());
-    return ret;
+void Datasource::setScalarCursor(void) {
+    /* The inline path cannot select a partition or record a trace */
+    if ( (decoder.GetFormat() & FormatRawScalars) &&
+         !(decoder.GetFormat() & FormatPartitioned) &&
+         trace == nullptr ) {
+        scalarCursor = &decoder.GetCursor();
+    } else {
+        scalarCursor = nullptr;
+    }
 }
 
-template <> types::Data<> Base::Get<types::Data<>>(const uint64_t id) {
-    const auto data = GetData(id);
-    types::Data<> ret(data.data(), data.size());
-    return ret;
+void Datasource::EnableArena(const size_t initialSize) {
+    arena.emplace(initialSize);
+    memoryResource = &(*arena);
 }
 
-template <class T>
-std::vector<T> Base::GetVector(const uint64_t id) {
-    std::vector<T> ret;
-
-    while ( Get<bool>(id) == true ) {
-        ret.push_back( Get<T>(id) );
-    }
+void Datasource::EnableArena(void* buffer, const size_t size) {
+    arena.emplace(buffer, size);
+    memoryResource = &(*arena);
+}
 
-    return ret;
+void Datasource::SetTrace(Trace* _trace) {
+    trace = _trace;
+    setScalarCursor();
 }
-#endif
 
-class Datasource : public Base
-{
-    private:
-        const uint8_t* data;
-        const size_t size;
-        size_t idx;
-        size_t left;
-        std::vector<uint8_t> get(const size_t min, const size_t max, const uint64_t id = 0) override;
-    public:
-        Datasource(const uint8_t* _data, const size_t _size);
-};
+void Datasource::record(Decoder& d, const size_t start, const uint64_t id, const size_t min, const size_t max, const size_t dataSize, const uint32_t flags) {
+    const auto& cursor = d.GetCursor();
 
-#ifndef FUZZING_HEADERS_NO_IMPL
-Datasource::Datasource(const uint8_t* _data, const size_t _size) :
-    Base(), data(_data), size(_size), idx(0), left(size)
-{
+    trace->Record({
+            id,
+            static_cast<uint64_t>(cursor.data - decoder.GetCursor().data) + start,
+            static_cast<uint32_t>(min),
+            static_cast<uint32_t>(max),
+            static_cast<uint32_t>(cursor.idx - start),
+            static_cast<uint32_t>(dataSize),
+            flags,
+            0});
 }
 
 std::vector<uint8_t> Datasource::get(const size_t min, const size_t max, const uint64_t id) {
-    (void)id;
+    const auto data = getSpan(min, max, id);
+    return std::vector<uint8_t>(data.begin(), data.end());
+}
 
-    uint32_t getSize;
-    if ( left < sizeof(getSize) ) {
-        throw OutOfData();
+Decoder& Datasource::getPartition(const uint64_t id) {
+    /* Consecutive reads often share an id */
+    if ( lastPartition < partitions.size() && partitions[lastPartition].first == id ) {
+        return partitions[lastPartition].second;
     }
-    memcpy(&getSize, data + idx, sizeof(getSize));
-    idx += sizeof(getSize);
-    left -= sizeof(getSize);
 
-    if ( getSize < min ) {
-        getSize = min;
+    for (size_t i = 0; i < partitions.size(); i++) {
+        if ( partitions[i].first == id ) {
+            lastPartition = i;
+            return partitions[i].second;
+        }
     }
-    if ( max && getSize > max ) {
-        getSize = max;
+
+    return *remainder;
+}
+
+Span<uint8_t> Datasource::getSpan(const size_t min, const size_t max, const uint64_t id) {
+    auto& d = getDecoder(id);
+
+    if ( trace != nullptr ) {
+        return getSpanTraced(d, min, max, id);
     }
 
-    if ( left < getSize ) {
-        throw OutOfData();
+    return d.Get(min, max);
+}
+
+Span<uint8_t> Datasource::getScalar(const size_t size, const uint64_t id) {
+    auto& d = getDecoder(id);
+
+    if ( trace != nullptr ) {
+        return getScalarTraced(d, size, id);
     }
 
-    std::vector<uint8_t> ret(getSize);
+    return d.GetScalar(size);
+}
+
+Span<uint8_t> Datasource::getSpanTraced(Decoder& d, const size_t min, const size_t max, const uint64_t id) {
+    const size_t start = d.GetCursor().idx;
+    try {
+        const auto ret = d.Get(min, max);
+        record(d, start, id, min, max, ret.size());
 
-    if ( getSize > 0 ) {
-        memcpy(ret.data(), data + idx, getSize);
+        return ret;
+    } catch ( OutOfData& ) {
+        record(d, start, id, min, max, 0, TraceEntry::kFailed);
+        throw;
     }
-    idx += getSize;
-    left -= getSize;
+}
 
-    return ret;
+Span<uint8_t> Datasource::getScalarTraced(Decoder& d, const size_t size, const uint64_t id) {
+    const size_t start = d.GetCursor().idx;
+    try {
+        const auto ret = d.GetScalar(size);
+        record(d, start, id, size, size, ret.size());
+
+        return ret;
+    } catch ( OutOfData& ) {
+        record(d, start, id, size, size, 0, TraceEntry::kFailed);
+        throw;
+    }
 }
 #endif
 
+/* Datasource without virtual dispatch. Reads through this class inline
+ * fully into the caller. Same input format as Datasource, except that
+ * FormatPartitioned is not supported; the constructor throws
+ * exception::LogicException if it is set. ArenaString and ArenaVector
+ * results are allocated from the default memory resource.
+ */
+class StaticDatasource final : public StaticBase<StaticDatasource>
+{
+    friend class StaticBase<StaticDatasource>;
+    private:
+        Decoder decoder;
+
+        Span<uint8_t> getSpan(const size_t min, const size_t max, const uint64_t id) {
+            (void)id;
+
+            return decoder.Get(min, max);
+        }
+
+        void readScalar(void* dest, const size_t size, const uint64_t id) {
+            (void)id;
+
+            memcpy(dest, decoder.GetScalar(size).data(), size);
+        }
+
+        uint32_t getFormat(void) const {
+            return decoder.GetFormat();
+        }
+
+        std::pmr::memory_resource* getMemoryResource(void) const {
+            return std::pmr::get_default_resource();
+        }
+    public:
+        StaticDatasource(const uint8_t* _data, const size_t _size, const uint32_t _format = FormatDefault) :
+            decoder(_data, _size, _format)
+        {
+            if ( _format & FormatPartitioned ) {
+                throw exception::LogicException("StaticDatasource: FormatPartitioned is not supported");
+            }
+        }
+};
+
 } /* namespace datasource */
 } /* namespace fuzzing */
@@ -2,6 +2,10 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <stdexcept>
 #include <utility>
 #include <map>
 
@@ -48,5 +52,146 @@ inline constexpr std::pair<const char*, uint64_t> IDPair(const char* const str,
 
 using IDMap = std::map<const char*, uint64_t>;
 
+inline constexpr uint64_t IDMix(uint64_t x, const uint64_t seed) noexcept {
+    /* splitmix64 finalizer */
+    x ^= seed;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+/* Compile-time set of the IDs a harness uses, with O(1) lookup of the
+ * name and of a dense index in [0, N) for each ID. The index can be used
+ * to keep per-ID state in flat arrays.
+ *
+ *   constexpr auto registry = MakeIDRegistry("content-type:json", "JsonTester.Multitest");
+ *   static_assert(registry.Index(ID("content-type:json")) == 0);
+ *
+ * The lookup table is a hash-and-displace perfect hash built during
+ * constant evaluation. Names whose IDs collide are rejected at
+ * compile time.
+ */
+template <size_t N>
+class IDRegistry {
+    private:
+        static constexpr size_t tableSize(void) {
+            size_t ret = 1;
+            while ( ret < N * 2 ) {
+                ret <<= 1;
+            }
+            return ret;
+        }
+    public:
+        static constexpr size_t kNumBuckets = N / 2 + 1;
+        static constexpr size_t kTableSize = tableSize();
+    private:
+        std::array<uint64_t, N> ids{};
+        std::array<const char*, N> names{};
+        std::array<uint64_t, kNumBuckets> displacements{};
+        /* Index + 1, or 0 if the slot is empty */
+        std::array<size_t, kTableSize> slots{};
+
+        static constexpr size_t bucket(const uint64_t id) {
+            return IDMix(id, 0) % kNumBuckets;
+        }
+
+        static constexpr size_t slot(const uint64_t id, const uint64_t displacement) {
+            return IDMix(id, displacement + 1) & (kTableSize - 1);
+        }
+    public:
+        constexpr IDRegistry(const std::array<const char*, N>& _names) {
+            for (size_t i = 0; i < N; i++) {
+                names[i] = _names[i];
+                ids[i] = ID(_names[i]);
+                for (size_t j = 0; j < i; j++) {
+                    if ( ids[j] == ids[i] ) {
+                        throw std::logic_error("IDRegistry: duplicate ID");
+                    }
+                }
+            }
+
+            /* Place the largest buckets first */
+            std::array<size_t, kNumBuckets> bucketSizes{};
+            for (size_t i = 0; i < N; i++) {
+                bucketSizes[bucket(ids[i])]++;
+            }
+
+            std::array<size_t, kNumBuckets> order{};
+            for (size_t i = 0; i < kNumBuckets; i++) {
+                order[i] = i;
+            }
+            for (size_t i = 1; i < kNumBuckets; i++) {
+                for (size_t j = i; j > 0 && bucketSizes[order[j - 1]] < bucketSizes[order[j]]; j--) {
+                    const auto tmp = order[j];
+                    order[j] = order[j - 1];
+                    order[j - 1] = tmp;
+                }
+            }
+
+            for (size_t o = 0; o < kNumBuckets && bucketSizes[order[o]] != 0; o++) {
+                const size_t b = order[o];
+
+                for (uint64_t d = 0; ; d++) {
+                    /* Try to place all members of the bucket with displacement d */
+                    std::array<size_t, kTableSize> candidate = slots;
+                    bool fits = true;
+
+                    for (size_t i = 0; i < N && fits; i++) {
+                        if ( bucket(ids[i]) != b ) {
+                            continue;
+                        }
+
+                        const size_t s = slot(ids[i], d);
+                        if ( candidate[s] != 0 ) {
+                            fits = false;
+                        } else {
+                            candidate[s] = i + 1;
+                        }
+                    }
+
+                    if ( fits == true ) {
+                        slots = candidate;
+                        displacements[b] = d;
+                        break;
+                    }
+                }
+            }
+        }
+
+        static constexpr size_t Size(void) {
+            return N;
+        }
+
+        constexpr std::optional<size_t> Index(const uint64_t id) const {
+            const size_t idx = slots[slot(id, displacements[bucket(id)])];
+            if ( idx == 0 || ids[idx - 1] != id ) {
+                return std::nullopt;
+            }
+            return idx - 1;
+        }
+
+        /* Returns nullptr for unknown IDs */
+        constexpr const char* Name(const uint64_t id) const {
+            const auto idx = Index(id);
+            return idx ? names[*idx] : nullptr;
+        }
+
+        constexpr uint64_t IDAt(const size_t index) const {
+            return ids[index];
+        }
+
+        constexpr const char* NameAt(const size_t index) const {
+            return names[index];
+        }
+};
+
+template <class... Names>
+constexpr IDRegistry<sizeof...(Names)> MakeIDRegistry(const Names... names) {
+    return IDRegistry<sizeof...(Names)>({names...});
+}
+
 } /* namespace datasource */
 } /* namespace fuzzing */
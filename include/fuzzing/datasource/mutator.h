@@ -1,51 +1,646 @@
 #pragma once
 
+#include <fuzzing/datasource/datasource.hpp>
+#include <fuzzing/datasource/trace.hpp>
 #include <fuzzing/mutator/mutator.h>
 #include <string.h>
+#include <algorithm>
+#include <functional>
+#include <vector>
 
 namespace fuzzing {
 namespace datasource {
 
+/* Structural mutator for the Datasource input format.
+ *
+ * The input is split into a table of length-prefixed chunks (one chunk
+ * per Datasource read). Whole chunks are then inserted, deleted,
+ * duplicated, swapped, shrunk, grown or replaced by a dictionary entry.
+ * The output is re-encoded with consistent length prefixes.
+ *
+ * With FormatPartitioned, a mutation either applies to the records
+ * themselves or to the chunks inside one record or the remainder. If a
+ * trace provider is set, new records are preferably created for ids that
+ * the target read without finding a record.
+ *
+ * CrossOver joins a prefix of one input to a suffix of another at chunk
+ * boundaries. If a trace provider is set, the cut points are chosen so
+ * that both sides continue with a read of the same id.
+ *
+ * Dictionaries added with an id are only used for chunks read with that
+ * id. The id of a chunk is its record id with FormatPartitioned, and
+ * otherwise comes from the trace provider.
+ *
+ * FormatRawScalars is not supported: without length prefixes the chunk
+ * boundaries cannot be found in the input, so the constructor throws a
+ * LogicException.
+ */
 class Mutator : public ::fuzzing::mutator::Base {
     public:
-        Mutator(void) : Base() { }
+        struct Chunk {
+            /* Start of the header */
+            size_t offset;
+            /* Record id (FormatPartitioned records only) plus length prefix */
+            size_t headerSize;
+            /* Data following the header */
+            size_t size;
+            uint64_t id;
+        };
+
+        /* Splits data into chunks, or into FormatPartitioned records if
+         * records == true. A chunk that claims more data than is left is
+         * truncated, while such a record ends the parse, as in Datasource.
+         * Returns the offset where parsing stopped; the bytes after it do
+         * not form a chunk, or are the remainder.
+         */
+        static size_t ParseChunks(const uint8_t* data, const size_t size, const uint32_t format, const bool records, std::vector<Chunk>& chunks);
+
+        /* Runs the target on data with a Datasource that records into
+         * trace, e.g.:
+         *
+         *   Datasource ds(data, size, format);
+         *   ds.SetTrace(&trace);
+         *   try { test(ds); } catch ( ... ) { }
+         */
+        using TraceProvider = std::function<void(const uint8_t* data, const size_t size, Trace& trace)>;
+    private:
+        enum Operation {
+            OpInsert,
+            OpDelete,
+            OpDuplicate,
+            OpShrink,
+            OpGrow,
+            OpSwap,
+            OpDictionary,
+            OpCount,
+        };
+
+        /* Output chunk: data followed by extra */
+        struct Piece {
+            uint64_t id;
+            const uint8_t* data;
+            size_t size;
+            const uint8_t* extra;
+            size_t extraSize;
+        };
+
+        const uint32_t format;
+
+        /* Reused across calls */
+        std::vector<Chunk> chunks;
+        std::vector<Chunk> records;
+        std::vector<Piece> pieces;
+        std::vector<uint8_t> inner;
+        std::vector<uint8_t> scratch;
+        std::vector<Chunk> otherChunks;
+        uint8_t randomBytes[16];
+
+        TraceProvider traceProvider;
+        Trace trace;
+        /* (chunk index, id) of each traced read that starts a chunk */
+        std::vector<std::pair<size_t, uint64_t>> chunkIDs;
+        std::vector<std::pair<size_t, uint64_t>> otherChunkIDs;
+
+        std::vector<std::pair<uint64_t, std::shared_ptr<::fuzzing::dictionary::Dictionary>>> typedDictionaries;
+
+        /* State of the current mutateChunks call */
+        const Chunk* parent = nullptr;
+        bool untyped = false;
+        bool traced = false;
+
+        bool getID(const uint8_t* data, const size_t size, const bool record, const size_t index, uint64_t& id);
+        bool getMissingID(const uint8_t* data, const size_t size, uint64_t& id);
+        ::fuzzing::dictionary::Dictionary* getDictionary(const bool hasID, const uint64_t id);
+        Piece newPiece(const uint64_t id, const bool hasID);
+        void putPiece(std::vector<uint8_t>& out, const Piece& piece, const bool record) const;
+        bool mutateChunks(const uint8_t* data, const size_t size, const bool record, std::vector<uint8_t>& out);
+        void traceChunks(const uint8_t* data, const size_t size, const std::vector<Chunk>& chunks, std::vector<std::pair<size_t, uint64_t>>& ids);
+        bool alignChunks(size_t& cut1, size_t& cut2);
+        void crossOverRecords(const uint8_t* data1, const size_t size1, const uint8_t* data2, const size_t size2);
+        void crossOverChunks(const uint8_t* data1, const size_t size1, const uint8_t* data2, const size_t size2);
+    public:
+        /* format must match the Datasource format of the target */
+        Mutator(const uint32_t format = FormatDefault);
         size_t Mutate(uint8_t* data, size_t size, const size_t maxSize) override;
+        size_t CrossOver(const uint8_t* data1, const size_t size1, const uint8_t* data2, const size_t size2, uint8_t* out, const size_t maxOutSize) override;
+
+        /* Align crossover cut points on matching ids. Reads beyond the
+         * most recent traceSize are not taken into account.
+         */
+        void SetTraceProvider(TraceProvider provider, const size_t traceSize = 4096);
+
+        using Base::AddSource;
+
+        /* Use d only for chunks read with id. Without FormatPartitioned,
+         * this requires a trace provider, which is then run on every
+         * input that is mutated.
+         */
+        void AddSource(const uint64_t id, std::shared_ptr<::fuzzing::dictionary::Dictionary> d);
 };
-        
+
 #ifndef FUZZING_HEADERS_NO_IMPL
-size_t Mutator::Mutate(uint8_t* data, size_t size, const size_t maxSize) {
-    uint32_t s;
-    if ( size < sizeof(s) ) {
-        goto end;
+Mutator::Mutator(const uint32_t format) :
+    Base(), format(format), trace(4096)
+{
+    if ( format & FormatRawScalars ) {
+        throw exception::LogicException("datasource::Mutator: FormatRawScalars is not supported");
     }
+}
 
-    if ( rand.RandBool() ) {
-        for (size_t i = 0; i < (size-sizeof(s)); ) {
-            //if ( rand.RandBool() ) {
-            if ( false ) {
-                //i += size % 1073741824;
-            } else {
-                /* Correct size prefix */
-                memcpy(&s, data + i, sizeof(s));
-                s %= size;
-                memcpy(data + i, &s, sizeof(s));
-                i += sizeof(s);
+size_t Mutator::ParseChunks(const uint8_t* data, const size_t size, const uint32_t format, const bool records, std::vector<Chunk>& chunks) {
+    chunks.clear();
+
+    size_t i = 0;
+    while ( i < size ) {
+        Chunk chunk = {i, 0, 0, 0};
+
+        if ( records == true ) {
+            if ( size - i <= sizeof(chunk.id) ) {
+                break;
+            }
+            memcpy(&chunk.id, data + i, sizeof(chunk.id));
+            chunk.headerSize += sizeof(chunk.id);
+        }
+
+        uint32_t length;
+        const size_t prefixSize = Decoder::DecodeLength(data + i + chunk.headerSize, size - i - chunk.headerSize, format, length);
+        if ( prefixSize == 0 ) {
+            break;
+        }
+        chunk.headerSize += prefixSize;
+
+        const size_t left = size - i - chunk.headerSize;
+        if ( records == true && length > left ) {
+            break;
+        }
+        chunk.size = length > left ? left : length;
+
+        chunks.push_back(chunk);
+        i += chunk.headerSize + chunk.size;
+    }
+
+    return i;
+}
+
+bool Mutator::getID(const uint8_t* data, const size_t size, const bool record, const size_t index, uint64_t& id) {
+    if ( record == true ) {
+        id = chunks[index].id;
+        return true;
+    }
+
+    if ( parent != nullptr ) {
+        id = parent->id;
+        return true;
+    }
+
+    if ( untyped == true ) {
+        return false;
+    }
+
+    if ( typedDictionaries.empty() || !traceProvider ) {
+        return false;
+    }
+
+    if ( traced == false ) {
+        traceChunks(data, size, chunks, chunkIDs);
+        traced = true;
+    }
+
+    /* chunkIDs is ordered by chunk index */
+    const auto it = std::lower_bound(
+            chunkIDs.begin(), chunkIDs.end(), index,
+            [](const std::pair<size_t, uint64_t>& a, const size_t b) { return a.first < b; });
+    if ( it == chunkIDs.end() || it->first != index ) {
+        return false;
+    }
+
+    id = it->second;
+    return true;
+}
+
+/* Picks an id that the target read, from a record or from the remainder,
+ * but that has no record in chunks.
+ */
+bool Mutator::getMissingID(const uint8_t* data, const size_t size, uint64_t& id) {
+    if ( !traceProvider ) {
+        return false;
+    }
+
+    trace.Clear();
+    traceProvider(data, size, trace);
+
+    size_t numMissing = 0;
+    for (size_t i = 0; i < trace.Size(); i++) {
+        const uint64_t traced = trace[i].id;
+
+        bool found = false;
+        for (const auto& chunk : chunks) {
+            if ( chunk.id == traced ) {
+                found = true;
+                break;
+            }
+        }
+        if ( found == true ) {
+            continue;
+        }
+
+        numMissing++;
+        if ( rand.Get(numMissing) == 0 ) {
+            id = traced;
+        }
+    }
+
+    return numMissing != 0;
+}
+
+::fuzzing::dictionary::Dictionary* Mutator::getDictionary(const bool hasID, const uint64_t id) {
+    if ( hasID == true ) {
+        ::fuzzing::dictionary::Dictionary* ret = nullptr;
+        size_t numMatches = 0;
+        for (const auto& typed : typedDictionaries) {
+            if ( typed.first != id ) {
+                continue;
+            }
+            numMatches++;
+            if ( rand.Get(numMatches) == 0 ) {
+                ret = typed.second.get();
+            }
+        }
+        if ( ret != nullptr ) {
+            return ret;
+        }
+    }
+
+    /* Untyped dictionaries apply to any chunk */
+    if ( dictionaries.empty() ) {
+        return nullptr;
+    }
+
+    return dictionaries[rand.Get(dictionaries.size())].get();
+}
 
-                if ( !dictionaries.empty() && rand.RandBool() ) {
-                    const std::string entry = dictionaries[rand.Get(dictionaries.size())]->GetRandom();
+Mutator::Piece Mutator::newPiece(const uint64_t id, const bool hasID) {
+    auto dictionary = getDictionary(hasID, id);
+    if ( dictionary != nullptr && rand.RandBool() ) {
+        const auto entry = dictionary->GetRandom(rand);
+        return {id, reinterpret_cast<const uint8_t*>(entry.data()), entry.size(), nullptr, 0};
+    }
+
+    const size_t size = rand.Get(sizeof(randomBytes) + 1);
+    rand.Fill(randomBytes, size);
+    return {id, randomBytes, size, nullptr, 0};
+}
+
+void Mutator::putPiece(std::vector<uint8_t>& out, const Piece& piece, const bool record) const {
+    if ( record == true ) {
+        const uint8_t* id = reinterpret_cast<const uint8_t*>(&piece.id);
+        out.insert(out.end(), id, id + sizeof(piece.id));
+    }
+
+    uint8_t prefix[Decoder::kMaxLengthSize];
+    const size_t prefixSize = Decoder::EncodeLength(prefix, piece.size + piece.extraSize, format);
+    out.insert(out.end(), prefix, prefix + prefixSize);
+
+    out.insert(out.end(), piece.data, piece.data + piece.size);
+    if ( piece.extraSize ) {
+        out.insert(out.end(), piece.extra, piece.extra + piece.extraSize);
+    }
+}
+
+bool Mutator::mutateChunks(const uint8_t* data, const size_t size, const bool record, std::vector<uint8_t>& out) {
+    const size_t end = ParseChunks(data, size, format, record, chunks);
+
+    pieces.clear();
+    for (const auto& chunk : chunks) {
+        pieces.push_back({chunk.id, data + chunk.offset + chunk.headerSize, chunk.size, nullptr, 0});
+    }
+
+    const size_t n = pieces.size();
+
+    traced = false;
 
-                    if ( s >= entry.size() && i + s < size ) {
-                        memcpy(data + i, entry.data(), entry.size());
+    switch ( rand.Get(OpCount) ) {
+        case    OpInsert:
+            {
+                const size_t pos = rand.Get(n + 1);
+                if ( record == true ) {
+                    /* A record is only useful with an id that is read:
+                     * one that has no record yet, or that of an existing
+                     * one. A new record holds a single chunk.
+                     */
+                    uint64_t id;
+                    if ( getMissingID(data, size, id) == true ) {
+                        inner.clear();
+                        putPiece(inner, newPiece(id, true), false);
+                        pieces.insert(pieces.begin() + pos, {id, inner.data(), inner.size(), nullptr, 0});
+                        break;
                     }
+
+                    if ( n == 0 ) {
+                        return false;
+                    }
+                    const auto piece = pieces[rand.Get(n)];
+                    pieces.insert(pieces.begin() + pos, piece);
+                    break;
+                }
+
+                /* Type the new chunk like the one it displaces. Nothing is
+                 * known about a read past the last chunk.
+                 */
+                uint64_t id = 0;
+                const bool hasID = pos < n && getID(data, size, record, pos, id);
+                pieces.insert(pieces.begin() + pos, newPiece(id, hasID));
+            }
+            break;
+        case    OpDelete:
+            if ( n == 0 ) {
+                return false;
+            }
+            pieces.erase(pieces.begin() + rand.Get(n));
+            break;
+        case    OpDuplicate:
+            {
+                if ( n == 0 ) {
+                    return false;
+                }
+                const auto piece = pieces[rand.Get(n)];
+                pieces.insert(pieces.begin() + rand.Get(n + 1), piece);
+            }
+            break;
+        case    OpShrink:
+            {
+                if ( n == 0 ) {
+                    return false;
                 }
+                auto& piece = pieces[rand.Get(n)];
+                if ( piece.size == 0 ) {
+                    return false;
+                }
+                piece.size = rand.Get(piece.size);
+            }
+            break;
+        case    OpGrow:
+            {
+                if ( n == 0 ) {
+                    return false;
+                }
+                const size_t which = rand.Get(n);
+                uint64_t id = 0;
+                const bool hasID = getID(data, size, record, which, id);
+                const auto extra = newPiece(id, hasID);
+                pieces[which].extra = extra.data;
+                pieces[which].extraSize = extra.size;
+            }
+            break;
+        case    OpSwap:
+            {
+                if ( n < 2 ) {
+                    return false;
+                }
+                const size_t a = rand.Get(n);
+                const size_t b = rand.Get(n);
+                if ( a == b ) {
+                    return false;
+                }
+                std::swap(pieces[a], pieces[b]);
+            }
+            break;
+        case    OpDictionary:
+            {
+                if ( n == 0 ) {
+                    return false;
+                }
+                const size_t which = rand.Get(n);
+                uint64_t id = 0;
+                const bool hasID = getID(data, size, record, which, id);
+                auto dictionary = getDictionary(hasID, id);
+                if ( dictionary == nullptr ) {
+                    return false;
+                }
+                auto& piece = pieces[which];
+                const auto entry = dictionary->GetRandom(rand);
+                piece.data = reinterpret_cast<const uint8_t*>(entry.data());
+                piece.size = entry.size();
+            }
+            break;
+    }
+
+    for (const auto& piece : pieces) {
+        putPiece(out, piece, record);
+    }
+
+    /* Keep the trailing bytes that do not form a chunk */
+    out.insert(out.end(), data + end, data + size);
+
+    return true;
+}
+
+size_t Mutator::Mutate(uint8_t* data, size_t size, const size_t maxSize) {
+    scratch.clear();
+
+    bool mutated = false;
+
+    for (size_t attempt = 0; attempt < 4 && mutated == false; attempt++) {
+        scratch.clear();
+
+        if ( (format & FormatPartitioned) && rand.RandBool() ) {
+            /* Mutate the chunks inside one record, or in the remainder */
+            const size_t end = ParseChunks(data, size, format, true, records);
+            const bool hasRemainder = end < size;
+            if ( records.empty() && hasRemainder == false ) {
+                continue;
+            }
+
+            const size_t which = rand.Get(records.size() + (hasRemainder ? 1 : 0));
+
+            inner.clear();
+            bool ok;
+            if ( which == records.size() ) {
+                /* Shared by all ids without a record */
+                untyped = true;
+                ok = mutateChunks(data + end, size - end, false, inner);
+                untyped = false;
+            } else {
+                const auto& record = records[which];
+                parent = &record;
+                ok = mutateChunks(data + record.offset + record.headerSize, record.size, false, inner);
+                parent = nullptr;
+            }
+            if ( ok == false ) {
+                continue;
+            }
+
+            for (size_t i = 0; i < records.size(); i++) {
+                const auto& r = records[i];
+                if ( i == which ) {
+                    putPiece(scratch, {r.id, inner.data(), inner.size(), nullptr, 0}, true);
+                } else {
+                    putPiece(scratch, {r.id, data + r.offset + r.headerSize, r.size, nullptr, 0}, true);
+                }
+            }
+            if ( which == records.size() ) {
+                scratch.insert(scratch.end(), inner.begin(), inner.end());
+            } else {
+                scratch.insert(scratch.end(), data + end, data + size);
+            }
+
+            mutated = true;
+        } else {
+            mutated = mutateChunks(data, size, format & FormatPartitioned, scratch);
+        }
+    }
+
+    if ( mutated == false || scratch.size() > maxSize ) {
+        return size;
+    }
+
+    if ( !scratch.empty() ) {
+        memcpy(data, scratch.data(), scratch.size());
+    }
+
+    return scratch.size();
+}
+
+void Mutator::AddSource(const uint64_t id, std::shared_ptr<::fuzzing::dictionary::Dictionary> d) {
+    typedDictionaries.emplace_back(id, d);
+}
+
+void Mutator::SetTraceProvider(TraceProvider provider, const size_t traceSize) {
+    traceProvider = std::move(provider);
+    trace = Trace(traceSize);
+}
+
+void Mutator::traceChunks(const uint8_t* data, const size_t size, const std::vector<Chunk>& chunks, std::vector<std::pair<size_t, uint64_t>>& ids) {
+    ids.clear();
+
+    trace.Clear();
+    traceProvider(data, size, trace);
+
+    /* Both the reads and the chunks are in input order */
+    size_t i = 0;
+    for (size_t j = 0; j < trace.Size() && i < chunks.size(); j++) {
+        const uint64_t offset = trace[j].offset;
+        while ( i < chunks.size() && chunks[i].offset < offset ) {
+            i++;
+        }
+        if ( i < chunks.size() && chunks[i].offset == offset ) {
+            ids.emplace_back(i, trace[j].id);
+            i++;
+        }
+    }
+}
+
+bool Mutator::alignChunks(size_t& cut1, size_t& cut2) {
+    if ( chunkIDs.empty() || otherChunkIDs.empty() ) {
+        return false;
+    }
+
+    const auto byID = [](const std::pair<size_t, uint64_t>& a, const std::pair<size_t, uint64_t>& b) {
+        return a.second < b.second;
+    };
+    std::sort(otherChunkIDs.begin(), otherChunkIDs.end(), byID);
+
+    /* Starting at a random read in the first input, find the first one
+     * whose id also occurs in the second input and pick one of those.
+     */
+    const size_t start = rand.Get(chunkIDs.size());
+    for (size_t i = 0; i < chunkIDs.size(); i++) {
+        const auto& first = chunkIDs[(start + i) % chunkIDs.size()];
+        const auto matches = std::equal_range(otherChunkIDs.begin(), otherChunkIDs.end(), first, byID);
+        if ( matches.first == matches.second ) {
+            continue;
+        }
+
+        cut1 = first.first;
+        cut2 = (matches.first + rand.Get(matches.second - matches.first))->first;
+        return true;
+    }
+
+    return false;
+}
+
+void Mutator::crossOverRecords(const uint8_t* data1, const size_t size1, const uint8_t* data2, const size_t size2) {
+    const size_t end1 = ParseChunks(data1, size1, format, true, records);
+    ParseChunks(data2, size2, format, true, otherChunks);
+
+    /* Records are keyed by id, so they are aligned by construction. Take
+     * each id from either input. Only the first record of an id is used
+     * by Datasource; later ones are kept where they are.
+     */
+    pieces.clear();
+    for (const auto& record : records) {
+        pieces.push_back({record.id, data1 + record.offset + record.headerSize, record.size, nullptr, 0});
+    }
+
+    for (const auto& other : otherChunks) {
+        if ( rand.RandBool() ) {
+            continue;
+        }
 
-                i += s;
+        const Piece piece = {other.id, data2 + other.offset + other.headerSize, other.size, nullptr, 0};
+
+        bool found = false;
+        for (auto& p : pieces) {
+            if ( p.id == other.id ) {
+                p = piece;
+                found = true;
+                break;
             }
         }
+
+        if ( found == false ) {
+            pieces.insert(pieces.begin() + rand.Get(pieces.size() + 1), piece);
+        }
+    }
+
+    for (const auto& piece : pieces) {
+        putPiece(scratch, piece, true);
+    }
+
+    scratch.insert(scratch.end(), data1 + end1, data1 + size1);
+}
+
+void Mutator::crossOverChunks(const uint8_t* data1, const size_t size1, const uint8_t* data2, const size_t size2) {
+    ParseChunks(data1, size1, format, false, chunks);
+    const size_t end2 = ParseChunks(data2, size2, format, false, otherChunks);
+
+    size_t cut1 = rand.Get(chunks.size() + 1);
+    size_t cut2 = rand.Get(otherChunks.size() + 1);
+
+    if ( traceProvider ) {
+        traceChunks(data1, size1, chunks, chunkIDs);
+        traceChunks(data2, size2, otherChunks, otherChunkIDs);
+        alignChunks(cut1, cut2);
     }
 
-end:
-    return size;
+    for (size_t i = 0; i < cut1; i++) {
+        const auto& chunk = chunks[i];
+        putPiece(scratch, {0, data1 + chunk.offset + chunk.headerSize, chunk.size, nullptr, 0}, false);
+    }
+    for (size_t i = cut2; i < otherChunks.size(); i++) {
+        const auto& chunk = otherChunks[i];
+        putPiece(scratch, {0, data2 + chunk.offset + chunk.headerSize, chunk.size, nullptr, 0}, false);
+    }
+
+    scratch.insert(scratch.end(), data2 + end2, data2 + size2);
+}
+
+size_t Mutator::CrossOver(const uint8_t* data1, const size_t size1, const uint8_t* data2, const size_t size2, uint8_t* out, const size_t maxOutSize) {
+    scratch.clear();
+
+    if ( format & FormatPartitioned ) {
+        crossOverRecords(data1, size1, data2, size2);
+    } else {
+        crossOverChunks(data1, size1, data2, size2);
+    }
+
+    if ( scratch.empty() || scratch.size() > maxOutSize ) {
+        return 0;
+    }
+
+    memcpy(out, scratch.data(), scratch.size());
+
+    return scratch.size();
 }
 #endif
 
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <unistd.h>
+#include <vector>
+
+namespace fuzzing {
+namespace datasource  {
+
+struct TraceEntry {
+    uint64_t id;
+    /* Offset in the input of the first byte consumed */
+    uint64_t offset;
+    uint32_t min;
+    uint32_t max;
+    /* Bytes consumed, including the length prefix if any */
+    uint32_t size;
+    /* Bytes returned to the caller */
+    uint32_t dataSize;
+    uint32_t flags;
+    uint32_t reserved;
+
+    /* The read ran out of data and threw OutOfData */
+    static const uint32_t kFailed = 1 << 0;
+};
+
+/* Records the most recent reads from a Datasource into a fixed-size ring
+ * buffer. Recording does not allocate.
+ *
+ * Dump format (host byte order):
+ *
+ *   uint32_t magic;   'FHTR'
+ *   uint32_t version; 2
+ *   uint64_t count;
+ *   TraceEntry entries[count]; oldest first
+ */
+class Trace {
+    private:
+        std::vector<TraceEntry> entries;
+        size_t total = 0;
+
+        bool write(const int fd, const void* data, size_t size) const;
+    public:
+        static const uint32_t kMagic = 0x52544846;
+        static const uint32_t kVersion = 2;
+
+        Trace(const size_t capacity);
+
+        void Record(const TraceEntry& entry) {
+            entries[total % entries.size()] = entry;
+            total++;
+        }
+
+        /* Number of entries currently held */
+        size_t Size(void) const {
+            return total < entries.size() ? total : entries.size();
+        }
+
+        /* Number of entries overwritten because the buffer was full */
+        size_t Dropped(void) const {
+            return total - Size();
+        }
+
+        /* i = 0 is the oldest entry held */
+        const TraceEntry& operator[](const size_t i) const {
+            return entries[(total - Size() + i) % entries.size()];
+        }
+
+        void Clear(void) {
+            total = 0;
+        }
+
+        /* Only uses write(2), so it can be called from a crash handler */
+        bool Dump(const int fd) const;
+};
+
+#ifndef FUZZING_HEADERS_NO_IMPL
+Trace::Trace(const size_t capacity) :
+    entries(capacity ? capacity : 1)
+{ }
+
+bool Trace::write(const int fd, const void* data, size_t size) const {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+
+    while ( size > 0 ) {
+        const auto ret = ::write(fd, p, size);
+        if ( ret <= 0 ) {
+            return false;
+        }
+        p += ret;
+        size -= ret;
+    }
+
+    return true;
+}
+
+bool Trace::Dump(const int fd) const {
+    const uint32_t magic = kMagic;
+    const uint32_t version = kVersion;
+    const uint64_t count = Size();
+
+    if ( write(fd, &magic, sizeof(magic)) == false ) {
+        return false;
+    }
+    if ( write(fd, &version, sizeof(version)) == false ) {
+        return false;
+    }
+    if ( write(fd, &count, sizeof(count)) == false ) {
+        return false;
+    }
+
+    /* The oldest entries may wrap around to the start of the buffer */
+    const size_t first = (total - count) % entries.size();
+    const size_t tail = entries.size() - first < count ? entries.size() - first : count;
+
+    if ( write(fd, entries.data() + first, tail * sizeof(TraceEntry)) == false ) {
+        return false;
+    }
+    if ( write(fd, entries.data(), (count - tail) * sizeof(TraceEntry)) == false ) {
+        return false;
+    }
+
+    return true;
+}
+#endif
+
+} /* namespace datasource */
+} /* namespace fuzzing */
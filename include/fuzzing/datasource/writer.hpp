@@ -0,0 +1,223 @@
+#pragma once
+
+#include <fuzzing/datasource/datasource.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace fuzzing {
+namespace datasource  {
+
+/* Produces inputs that decode to the given values.
+ *
+ * Each Put* method is the inverse of the corresponding Get* method of
+ * Datasource, for the same format flags. E.g.:
+ *
+ *   DatasourceWriter writer;
+ *   writer.PutIndex(12, 0, datasource::ID("JsonTester.Multitest"));
+ *   writer.Put<std::string>("{}", datasource::ID("content-type:json"));
+ *   writer.Put<bool>(true, ...);
+ *   const auto seed = writer.Get();
+ */
+class DatasourceWriter {
+    private:
+        const uint32_t format;
+
+        /* One stream per id with FormatPartitioned, otherwise one stream */
+        std::vector<std::pair<uint64_t, std::vector<uint8_t>>> streams;
+
+        std::vector<uint8_t>& getStream(const uint64_t id);
+        void putLength(std::vector<uint8_t>& out, const uint32_t length);
+        void putBytes(std::vector<uint8_t>& out, const void* data, const size_t size);
+        void putScalar(const void* data, const size_t size, const uint64_t id);
+    public:
+        DatasourceWriter(const uint32_t format = FormatDefault);
+
+        template <class T> void Put(const T& value, const uint64_t id = 0) {
+            if constexpr ( std::is_same<T, bool>::value ) {
+                const uint8_t v = value ? 1 : 0;
+                putScalar(&v, sizeof(v), id);
+            } else if constexpr ( std::is_same<T, std::string>::value || std::is_same<T, ArenaString>::value ) {
+                PutData(value.data(), value.size(), id);
+            } else if constexpr ( std::is_same<T, std::vector<std::string>>::value || std::is_same<T, ArenaVector<ArenaString>>::value ) {
+                /* Get<std::vector<std::string>> always reads at least one string */
+                if ( value.empty() ) {
+                    PutData(nullptr, 0, id);
+                    Put<bool>(false, id);
+                    return;
+                }
+                for (size_t i = 0; i < value.size(); i++) {
+                    PutData(value[i].data(), value[i].size(), id);
+                    Put<bool>(i + 1 < value.size(), id);
+                }
+            } else if constexpr ( std::is_same<T, types::String<>>::value || std::is_same<T, types::Data<>>::value ) {
+                PutData(value.data(), value.size(), id);
+            } else {
+                /* E.g. Put("literal") would write the bytes of the array
+                 * as one scalar; use PutStringView or PutData instead.
+                 */
+                static_assert(!std::is_array<T>::value && !std::is_pointer<T>::value, "Put() does not take arrays or pointers");
+                static_assert(std::is_trivially_copyable<T>::value);
+                putScalar(&value, sizeof(value), id);
+            }
+        }
+
+        void PutData(const void* data, const size_t size, const uint64_t id = 0);
+
+        void PutData(const std::vector<uint8_t>& data, const uint64_t id = 0) {
+            PutData(data.data(), data.size(), id);
+        }
+
+        void PutStringView(const std::string_view s, const uint64_t id = 0) {
+            PutData(s.data(), s.size(), id);
+        }
+
+        template <class Vector> void PutVector(const Vector& v, const uint64_t id = 0) {
+            using T = typename Vector::value_type;
+
+            if constexpr ( std::is_trivially_copyable<T>::value ) {
+                if ( format & FormatBulkVectors ) {
+                    if constexpr ( std::is_same<T, bool>::value ) {
+                        std::vector<uint8_t> bytes(v.begin(), v.end());
+                        PutData(bytes.data(), bytes.size(), id);
+                    } else {
+                        PutData(v.data(), v.size() * sizeof(T), id);
+                    }
+                    return;
+                }
+            }
+
+            for (const auto& element : v) {
+                Put<bool>(true, id);
+                Put<T>(element, id);
+            }
+            Put<bool>(false, id);
+        }
+
+        /* Inverse of GetChoice(id) */
+        void PutChoice(const uint16_t choice, const uint64_t id = 0) {
+            Put<uint16_t>(choice, id);
+        }
+
+        /* Inverse of GetRange(lo, hi) */
+        void PutRange(const uint64_t lo, const uint64_t hi, const uint64_t value, const uint64_t id = 0);
+
+        /* Inverse of GetIndex(n, id) */
+        void PutIndex(const size_t n, const size_t index, const uint64_t id = 0) {
+            PutRange(0, n ? n - 1 : 0, index, id);
+        }
+
+        /* The encoded input */
+        std::vector<uint8_t> Get(void) const;
+};
+
+#ifndef FUZZING_HEADERS_NO_IMPL
+DatasourceWriter::DatasourceWriter(const uint32_t format) :
+    format(format)
+{ }
+
+std::vector<uint8_t>& DatasourceWriter::getStream(const uint64_t id) {
+    if ( !(format & FormatPartitioned) ) {
+        if ( streams.empty() ) {
+            streams.emplace_back(0, std::vector<uint8_t>());
+        }
+        return streams[0].second;
+    }
+
+    for (auto& stream : streams) {
+        if ( stream.first == id ) {
+            return stream.second;
+        }
+    }
+
+    streams.emplace_back(id, std::vector<uint8_t>());
+    return streams.back().second;
+}
+
+void DatasourceWriter::putLength(std::vector<uint8_t>& out, const uint32_t length) {
+    uint8_t prefix[Decoder::kMaxLengthSize];
+    const size_t prefixSize = Decoder::EncodeLength(prefix, length, format);
+    putBytes(out, prefix, prefixSize);
+}
+
+void DatasourceWriter::putBytes(std::vector<uint8_t>& out, const void* data, const size_t size) {
+    if ( size == 0 ) {
+        return;
+    }
+
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    out.insert(out.end(), p, p + size);
+}
+
+void DatasourceWriter::putScalar(const void* data, const size_t size, const uint64_t id) {
+    auto& out = getStream(id);
+
+    if ( !(format & FormatRawScalars) ) {
+        putLength(out, size);
+    }
+    putBytes(out, data, size);
+}
+
+void DatasourceWriter::PutData(const void* data, const size_t size, const uint64_t id) {
+    auto& out = getStream(id);
+
+    putLength(out, size);
+    putBytes(out, data, size);
+}
+
+void DatasourceWriter::PutRange(const uint64_t lo, const uint64_t hi, const uint64_t value, const uint64_t id) {
+    if ( lo >= hi ) {
+        return;
+    }
+
+    if ( value < lo || value > hi ) {
+        throw exception::LogicException("PutRange: value out of range");
+    }
+
+    const uint64_t range = hi - lo;
+
+    if ( range == UINT64_MAX ) {
+        putScalar(&value, sizeof(value), id);
+        return;
+    }
+
+    const size_t numBytes = RangeNumBytes(range);
+    const uint64_t v = value - lo;
+
+    uint8_t bytes[sizeof(uint64_t)];
+    for (size_t i = 0; i < numBytes; i++) {
+        bytes[i] = (v >> (i * 8)) & 0xFF;
+    }
+
+    putScalar(bytes, numBytes, id);
+}
+
+std::vector<uint8_t> DatasourceWriter::Get(void) const {
+    if ( !(format & FormatPartitioned) ) {
+        return streams.empty() ? std::vector<uint8_t>() : streams[0].second;
+    }
+
+    std::vector<uint8_t> ret;
+
+    for (const auto& stream : streams) {
+        const uint8_t* id = reinterpret_cast<const uint8_t*>(&stream.first);
+        ret.insert(ret.end(), id, id + sizeof(stream.first));
+
+        uint8_t prefix[Decoder::kMaxLengthSize];
+        const size_t prefixSize = Decoder::EncodeLength(prefix, stream.second.size(), format);
+        ret.insert(ret.end(), prefix, prefix + prefixSize);
+
+        ret.insert(ret.end(), stream.second.begin(), stream.second.end());
+    }
+
+    return ret;
+}
+#endif
+
+} /* namespace datasource */
+} /* namespace fuzzing */
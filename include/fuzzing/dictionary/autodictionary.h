@@ -0,0 +1,255 @@
+#pragma once
+
+#include <fuzzing/dictionary/dictionary.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/* The capture path runs inside the comparison hooks, so it must not be
+ * instrumented itself.
+ */
+#if defined(__clang__)
+#define FUZZING_NO_COVERAGE __attribute__((no_sanitize("coverage")))
+#elif defined(__GNUC__) && __GNUC__ >= 12
+#define FUZZING_NO_COVERAGE __attribute__((no_sanitize_coverage))
+#else
+#define FUZZING_NO_COVERAGE
+#endif
+
+namespace fuzzing {
+namespace dictionary {
+
+/* Collects the operands of comparisons made by the target into a fixed
+ * table, to be moved into a Dictionary later.
+ *
+ * Capture() does not allocate or lock and may be called from any thread,
+ * or from another process if the table is in shared memory. An operand
+ * whose slot is taken is dropped. Flush() may run while other threads
+ * read the destination dictionary, but not concurrently with itself.
+ *
+ * With FUZZING_AUTODICTIONARY_HOOKS defined, this header also defines the
+ * -fsanitize-coverage=trace-cmp callbacks and the sanitizer memcmp/strcmp
+ * hooks, which capture into *autoDictionaryTable. The memcmp/strcmp hooks
+ * are called by the sanitizer interceptors, so they need e.g. ASan.
+ *
+ * libFuzzer defines these symbols itself, so the hooks are meant for
+ * targets run by binaryexecutorcoverage: build the target and its client
+ * with -fsanitize-coverage=trace-pc-guard,trace-cmp and
+ * -DFUZZING_AUTODICTIONARY_HOOKS. The client then captures into a table
+ * shared with BinaryExecutorCoverage, which flushes it after every run
+ * into GetAutoDictionary().Get(), e.g. for datasource::Mutator::AddSource.
+ */
+class AutoDictionary {
+    public:
+        static const size_t kNumSlots = 1 << 12;
+        static const size_t kMaxSize = 32;
+
+        struct Slot {
+            std::atomic<uint32_t> state;
+            uint32_t size;
+            uint8_t data[kMaxSize];
+        };
+
+        /* All zero bytes is an empty table, so a fresh shared memory
+         * mapping can be used as is.
+         */
+        struct Table {
+            std::atomic<size_t> pending;
+            Slot slots[kNumSlots];
+        };
+    private:
+        enum State : uint32_t {
+            SlotEmpty,
+            SlotWriting,
+            SlotReady,
+        };
+
+        Table* table;
+        std::shared_ptr<Dictionary> dictionary;
+    public:
+        /* Flushes from table, which must outlive this object */
+        AutoDictionary(Table* table);
+
+        FUZZING_NO_COVERAGE static void Capture(Table& table, const void* data, const size_t size);
+        FUZZING_NO_COVERAGE static void CaptureInteger(Table& table, const uint64_t value, const size_t size);
+
+        /* Dictionary that Flush() adds to, for use with AddSource() */
+        std::shared_ptr<Dictionary> Get(void) {
+            return dictionary;
+        }
+
+        /* Moves the captured operands into the dictionary. Cheap if there
+         * are none. Returns the number of new entries.
+         */
+        size_t Flush(void);
+};
+
+#ifndef FUZZING_HEADERS_NO_IMPL
+AutoDictionary::AutoDictionary(Table* table) :
+    table(table), dictionary(std::make_shared<Dictionary>())
+{ }
+
+void AutoDictionary::Capture(Table& table, const void* data, const size_t size) {
+    if ( size == 0 || size > kMaxSize ) {
+        return;
+    }
+
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+
+    /* FNV-1a; equal operands land in the same slot */
+    uint32_t h = 0x811c9dc5;
+    for (size_t i = 0; i < size; i++) {
+        h ^= p[i];
+        h *= 0x01000193;
+    }
+
+    Slot& slot = table.slots[h % kNumSlots];
+
+    uint32_t expected = SlotEmpty;
+    if ( slot.state.compare_exchange_strong(expected, SlotWriting, std::memory_order_acquire, std::memory_order_relaxed) == false ) {
+        return;
+    }
+
+    /* A loop rather than memcpy, which may be intercepted */
+    for (size_t i = 0; i < size; i++) {
+        slot.data[i] = p[i];
+    }
+    slot.size = size;
+
+    slot.state.store(SlotReady, std::memory_order_release);
+    table.pending.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AutoDictionary::CaptureInteger(Table& table, const uint64_t value, const size_t size) {
+    /* Small values are mostly loop bounds and flags */
+    if ( value < 0x100 || value == UINT64_MAX ) {
+        return;
+    }
+
+    uint8_t bytes[sizeof(value)];
+    for (size_t i = 0; i < size; i++) {
+        bytes[i] = (value >> (i * 8)) & 0xFF;
+    }
+    Capture(table, bytes, size);
+}
+
+size_t AutoDictionary::Flush(void) {
+    if ( table->pending.load(std::memory_order_relaxed) == 0 ) {
+        return 0;
+    }
+    table->pending.store(0, std::memory_order_relaxed);
+
+    size_t ret = 0;
+    for (auto& slot : table->slots) {
+        if ( slot.state.load(std::memory_order_acquire) != SlotReady ) {
+            continue;
+        }
+
+        if ( dictionary->Add(std::string_view(reinterpret_cast<const char*>(slot.data), slot.size)) == true ) {
+            ret++;
+        }
+
+        slot.state.store(SlotEmpty, std::memory_order_release);
+    }
+
+    return ret;
+}
+
+/* Neither needs dynamic initialization, so hooks that run before the
+ * static constructors, or a client that repoints the table early, are
+ * safe.
+ */
+AutoDictionary::Table localAutoDictionaryTable;
+AutoDictionary::Table* autoDictionaryTable = &localAutoDictionaryTable;
+
+/* Flushes the table of this process */
+AutoDictionary autoDictionary(&localAutoDictionaryTable);
+#endif
+
+} /* namespace dictionary */
+} /* namespace fuzzing */
+
+#if defined(FUZZING_AUTODICTIONARY_HOOKS) && !defined(FUZZING_HEADERS_NO_IMPL)
+extern "C" {
+
+FUZZING_NO_COVERAGE void __sanitizer_cov_trace_cmp1(uint8_t arg1, uint8_t arg2) {
+    /* Single bytes are left to the byte-level mutators */
+    (void)arg1; (void)arg2;
+}
+
+FUZZING_NO_COVERAGE void __sanitizer_cov_trace_const_cmp1(uint8_t arg1, uint8_t arg2) {
+    (void)arg1; (void)arg2;
+}
+
+#define FUZZING_TRACE_CMP(bytes, bits) \
+    FUZZING_NO_COVERAGE void __sanitizer_cov_trace_cmp ## bytes(uint ## bits ## _t arg1, uint ## bits ## _t arg2) { \
+        if ( arg1 != arg2 ) { \
+            fuzzing::dictionary::AutoDictionary::CaptureInteger(*fuzzing::dictionary::autoDictionaryTable, arg1, sizeof(arg1)); \
+            fuzzing::dictionary::AutoDictionary::CaptureInteger(*fuzzing::dictionary::autoDictionaryTable, arg2, sizeof(arg2)); \
+        } \
+    } \
+    FUZZING_NO_COVERAGE void __sanitizer_cov_trace_const_cmp ## bytes(uint ## bits ## _t arg1, uint ## bits ## _t arg2) { \
+        /* arg1 is the constant */ \
+        if ( arg1 != arg2 ) { \
+            fuzzing::dictionary::AutoDictionary::CaptureInteger(*fuzzing::dictionary::autoDictionaryTable, arg1, sizeof(arg1)); \
+        } \
+    }
+
+FUZZING_TRACE_CMP(2, 16)
+FUZZING_TRACE_CMP(4, 32)
+FUZZING_TRACE_CMP(8, 64)
+
+#undef FUZZING_TRACE_CMP
+
+FUZZING_NO_COVERAGE void __sanitizer_cov_trace_switch(uint64_t val, uint64_t* cases) {
+    /* cases[0] is the number of cases, cases[1] their width in bits */
+    if ( cases[1] <= 8 ) {
+        return;
+    }
+
+    for (uint64_t i = 0; i < cases[0]; i++) {
+        if ( cases[2 + i] != val ) {
+            fuzzing::dictionary::AutoDictionary::CaptureInteger(*fuzzing::dictionary::autoDictionaryTable, cases[2 + i], cases[1] / 8);
+        }
+    }
+}
+
+FUZZING_NO_COVERAGE void __sanitizer_weak_hook_memcmp(void* caller_pc, const void* s1, const void* s2, size_t n, int result) {
+    (void)caller_pc;
+
+    if ( result == 0 ) {
+        return;
+    }
+
+    fuzzing::dictionary::AutoDictionary::Capture(*fuzzing::dictionary::autoDictionaryTable, s1, n);
+    fuzzing::dictionary::AutoDictionary::Capture(*fuzzing::dictionary::autoDictionaryTable, s2, n);
+}
+
+FUZZING_NO_COVERAGE static size_t fuzzing_autodictionary_strlen(const char* s, const size_t max) {
+    size_t ret = 0;
+    while ( ret < max && s[ret] != 0 ) {
+        ret++;
+    }
+    return ret;
+}
+
+FUZZING_NO_COVERAGE void __sanitizer_weak_hook_strncmp(void* caller_pc, const char* s1, const char* s2, size_t n, int result) {
+    (void)caller_pc;
+
+    if ( result == 0 ) {
+        return;
+    }
+
+    /* Longer strings would be dropped anyway */
+    const size_t max = n < fuzzing::dictionary::AutoDictionary::kMaxSize + 1 ? n : fuzzing::dictionary::AutoDictionary::kMaxSize + 1;
+    fuzzing::dictionary::AutoDictionary::Capture(*fuzzing::dictionary::autoDictionaryTable, s1, fuzzing_autodictionary_strlen(s1, max));
+    fuzzing::dictionary::AutoDictionary::Capture(*fuzzing::dictionary::autoDictionaryTable, s2, fuzzing_autodictionary_strlen(s2, max));
+}
+
+FUZZING_NO_COVERAGE void __sanitizer_weak_hook_strcmp(void* caller_pc, const char* s1, const char* s2, int result) {
+    __sanitizer_weak_hook_strncmp(caller_pc, s1, s2, SIZE_MAX, result);
+}
+
+} /* extern "C" */
+#endif
@@ -1,37 +1,166 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
 #include <vector>
 #include <fuzzing/util/random.h>
 
 namespace fuzzing {
 namespace dictionary {
 
+/* Entries are stored back to back in a byte arena of blocks that are
+ * never moved or freed, indexed by an entry table. Add() ignores entries
+ * that are already present.
+ *
+ * Thread-safe: any number of threads may call GetRandom(rand) with their
+ * own generators while others call Add().
+ */
 class Dictionary {
     private:
-        ::fuzzing::util::Random rand;
-        std::vector<std::string> dictionary;
+        struct Entry {
+            const char* data;
+            uint32_t size;
+        };
+
+        static const size_t kBlockSize = 64 * 1024;
+
+        mutable std::shared_mutex mutex;
+        std::vector<std::unique_ptr<char[]>> blocks;
+        char* blockPos = nullptr;
+        size_t blockLeft = 0;
+        std::vector<Entry> entries;
+
+        /* Open addressing hash table of entry index + 1, 0 if empty */
+        std::vector<uint32_t> table;
+        std::vector<uint64_t> hashes;
+
+        static uint64_t hash(const std::string_view s);
+        std::string_view get(const size_t index) const {
+            return std::string_view(entries[index].data, entries[index].size);
+        }
+        void newBlock(const size_t size);
+        void grow(void);
     public:
         Dictionary(void);
         Dictionary(std::vector<std::string>& dictionary);
 
-        std::string GetRandom(void);
-        void Add(const std::string& s);
+        /* The view is valid for the lifetime of the dictionary */
+        std::string_view GetRandom(::fuzzing::util::Random& rand) const;
+
+        /* Returns false if s was already present */
+        bool Add(const std::string_view s);
+
+        size_t Size(void) const {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            return entries.size();
+        }
+
+        /* Pre-allocate for numEntries entries of numBytes bytes in total */
+        void Reserve(const size_t numEntries, const size_t numBytes);
 };
 
 #ifndef FUZZING_HEADERS_NO_IMPL
 Dictionary::Dictionary(void) { };
-Dictionary::Dictionary(std::vector<std::string>& dictionary) : dictionary(dictionary) { }
+Dictionary::Dictionary(std::vector<std::string>& dictionary) {
+    for (const auto& s : dictionary) {
+        Add(s);
+    }
+}
+
+uint64_t Dictionary::hash(const std::string_view s) {
+    /* FNV-1a */
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (const char c : s) {
+        h ^= static_cast<uint8_t>(c);
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+void Dictionary::newBlock(const size_t size) {
+    blocks.emplace_back(new char[size]);
+    blockPos = blocks.back().get();
+    blockLeft = size;
+}
+
+void Dictionary::grow(void) {
+    std::vector<uint32_t> newTable(table.empty() ? 64 : table.size() * 2, 0);
+    const size_t mask = newTable.size() - 1;
+
+    for (size_t i = 0; i < entries.size(); i++) {
+        size_t slot = hashes[i] & mask;
+        while ( newTable[slot] != 0 ) {
+            slot = (slot + 1) & mask;
+        }
+        newTable[slot] = i + 1;
+    }
+
+    table.swap(newTable);
+}
+
+std::string_view Dictionary::GetRandom(::fuzzing::util::Random& rand) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+
+    if ( entries.empty() ) {
+        return std::string_view();
+    }
+
+    return get(rand.Get(entries.size()));
+}
+
+bool Dictionary::Add(const std::string_view s) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+
+    /* Keep the load factor at or below 1/2 */
+    if ( (entries.size() + 1) * 2 > table.size() ) {
+        grow();
+    }
 
-std::string Dictionary::GetRandom(void) {
-    if ( dictionary.empty() ) {
-        return std::string();
+    const uint64_t h = hash(s);
+    const size_t mask = table.size() - 1;
+
+    size_t slot = h & mask;
+    while ( table[slot] != 0 ) {
+        const size_t index = table[slot] - 1;
+        if ( hashes[index] == h && get(index) == s ) {
+            return false;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    if ( s.size() > blockLeft ) {
+        newBlock(s.size() > kBlockSize ? s.size() : kBlockSize);
     }
+    if ( !s.empty() ) {
+        memcpy(blockPos, s.data(), s.size());
+    }
+
+    table[slot] = entries.size() + 1;
+    entries.push_back({blockPos, static_cast<uint32_t>(s.size())});
+    hashes.push_back(h);
+    blockPos += s.size();
+    blockLeft -= s.size();
 
-    return dictionary[ rand.Get(dictionary.size()) ];
+    return true;
 }
-        
-void Dictionary::Add(const std::string& s) {
-    dictionary.push_back( s );
+
+void Dictionary::Reserve(const size_t numEntries, const size_t numBytes) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+
+    if ( numBytes > blockLeft ) {
+        newBlock(numBytes);
+    }
+    entries.reserve(numEntries);
+    hashes.reserve(numEntries);
+    while ( numEntries * 2 > table.size() ) {
+        grow();
+    }
 }
 #endif
 
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <fuzzing/dictionary/dictionary.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+
+namespace fuzzing {
+namespace dictionary {
+
+/* Reads dictionaries in the AFL/libFuzzer format:
+ *
+ *   # comment
+ *   "GET"
+ *   kw_post="POST"
+ *   kw_crlf@1="\x0d\x0a"
+ *
+ * Inside the quotes, \\, \" and \xHH are the only escapes. Names and
+ * levels are ignored.
+ */
+class Loader {
+    private:
+        /* Unescaped entry, reused across lines */
+        std::string entry;
+
+        static int hexValue(const char c);
+        bool parseLine(const char* line, const char* end);
+    public:
+        /* Adds every entry to dictionary. Malformed lines are skipped;
+         * returns false if there were any.
+         */
+        bool Parse(Dictionary& dictionary, const char* data, const size_t size);
+
+        /* Maps the file at path and parses it. Returns false if the file
+         * could not be read or had malformed lines.
+         */
+        bool Load(Dictionary& dictionary, const char* path);
+};
+
+#ifndef FUZZING_HEADERS_NO_IMPL
+int Loader::hexValue(const char c) {
+    if ( c >= '0' && c <= '9' ) {
+        return c - '0';
+    } else if ( c >= 'a' && c <= 'f' ) {
+        return c - 'a' + 10;
+    } else if ( c >= 'A' && c <= 'F' ) {
+        return c - 'A' + 10;
+    }
+
+    return -1;
+}
+
+bool Loader::parseLine(const char* line, const char* end) {
+    entry.clear();
+
+    /* Trim trailing whitespace */
+    while ( end > line && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r') ) {
+        end--;
+    }
+
+    const char* quote = static_cast<const char*>(memchr(line, '"', end - line));
+    if ( quote == nullptr || end - quote < 2 || end[-1] != '"' ) {
+        return false;
+    }
+
+    for (const char* p = quote + 1; p < end - 1; p++) {
+        if ( *p != '\\' ) {
+            entry.push_back(*p);
+            continue;
+        }
+
+        p++;
+        if ( p == end - 1 ) {
+            return false;
+        }
+
+        if ( *p == '\\' || *p == '"' ) {
+            entry.push_back(*p);
+        } else if ( *p == 'x' && end - 1 - p > 2 && hexValue(p[1]) != -1 && hexValue(p[2]) != -1 ) {
+            entry.push_back(static_cast<char>(hexValue(p[1]) * 16 + hexValue(p[2])));
+            p += 2;
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Loader::Parse(Dictionary& dictionary, const char* data, const size_t size) {
+    /* The entries never take more space than the file */
+    dictionary.Reserve(0, size);
+
+    bool ret = true;
+    const char* end = data + size;
+
+    while ( data < end ) {
+        const char* newline = static_cast<const char*>(memchr(data, '\n', end - data));
+        const char* lineEnd = newline ? newline : end;
+
+        while ( data < lineEnd && (*data == ' ' || *data == '\t') ) {
+            data++;
+        }
+
+        if ( data < lineEnd && *data != '#' && *data != '\r' ) {
+            if ( parseLine(data, lineEnd) == true ) {
+                dictionary.Add(entry);
+            } else {
+                ret = false;
+            }
+        }
+
+        data = newline ? newline + 1 : end;
+    }
+
+    return ret;
+}
+
+bool Loader::Load(Dictionary& dictionary, const char* path) {
+    const int fd = open(path, O_RDONLY);
+    if ( fd == -1 ) {
+        return false;
+    }
+
+    struct stat st;
+    if ( fstat(fd, &st) != 0 ) {
+        close(fd);
+        return false;
+    }
+
+    if ( st.st_size == 0 ) {
+        close(fd);
+        return true;
+    }
+
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if ( data == MAP_FAILED ) {
+        return false;
+    }
+
+    const bool ret = Parse(dictionary, static_cast<const char*>(data), st.st_size);
+
+    munmap(data, st.st_size);
+
+    return ret;
+}
+#endif
+
+} /* namespace dictionary */
+} /* namespace fuzzing */
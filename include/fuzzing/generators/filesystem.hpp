@@ -24,8 +24,9 @@ class FlowException : public global_FlowException {
         FlowException() : global_FlowException() { }
 };
 
-static const std::string generateFilename(datasource::Datasource& ds) {
-    auto filename = ds.Get<std::string>();
+template <class DatasourceType>
+static const std::string generateFilename(DatasourceType& ds) {
+    auto filename = ds.template Get<std::string>();
     if ( filename.empty() ) {
         throw FlowException();
     }
@@ -74,7 +75,8 @@ class FileAttributes {
         const std::string name;
         /* TODO date etc */
     public:
-        FileAttributes(datasource::Datasource ds) :
+        template <class DatasourceType>
+        FileAttributes(DatasourceType ds) :
             name(generateFilename(ds))
         { }
 
@@ -106,7 +108,8 @@ class AbstractFile {
         }
 
     public:
-        AbstractFile(datasource::Datasource ds, const std::string basePath) :
+        template <class DatasourceType>
+        AbstractFile(DatasourceType ds, const std::string basePath) :
         attributes(ds),
         basePath(basePath)
         { }
@@ -125,12 +128,13 @@ class AbstractFile {
 
 class File : public AbstractFile {
     private:
-        const std::vector<uint8_t> content;
+        const datasource::ArenaVector<uint8_t> content;
 
     public:
-        File(datasource::Datasource& ds, const std::string basePath) :
+        template <class DatasourceType>
+        File(DatasourceType& ds, const std::string basePath) :
         AbstractFile(ds, basePath),
-        content( ds.GetVector<uint8_t>() )
+        content( ds.template GetArenaVector<uint8_t>() )
         { }
 
         bool Write(void) const override {
@@ -213,7 +217,7 @@ end:
             }
 
             /* Content should match */
-            if ( content_copy != content ) {
+            if ( memcmp(content_copy.data(), content.data(), content.size()) != 0 ) {
                 goto end;
             }
 
@@ -295,13 +299,14 @@ class Directory : public AbstractFile {
         }
 
     public:
-        Directory(datasource::Datasource& ds, const std::string basePath, const int depth = 0) :
+        template <class DatasourceType>
+        Directory(DatasourceType& ds, const std::string basePath, const int depth = 0) :
         AbstractFile(ds, basePath)
         {
-            while ( ds.Get<bool>() == true ) {
+            while ( ds.template Get<bool>() == true ) {
                 std::shared_ptr<AbstractFile> newFile;
 
-                if ( ds.Get<bool>() == true ) {
+                if ( ds.template Get<bool>() == true ) {
                     newFile = std::make_shared<File>(ds, getFullPath());
                 } else {
                     if ( depth + 1 > 4096 ) {
@@ -407,7 +412,8 @@ class Filesystem {
     private:
         std::shared_ptr<AbstractFile> fsRoot;
     public:
-        Filesystem(datasource::Datasource& ds, const std::string fsRootPath) :
+        template <class DatasourceType>
+        Filesystem(DatasourceType& ds, const std::string fsRootPath) :
             fsRoot( std::make_shared<Directory>(ds, fsRootPath) )
         { }
 
@@ -1,40 +1,283 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <fuzzing/util/forkserver.hpp>
+#if defined(FUZZING_AUTODICTIONARY_HOOKS)
+#include <fuzzing/dictionary/autodictionary.h>
+#endif
+#include "client.h"
 #include "shared.hpp"
 
-static uint8_t Counters[kNumPCs];
+/* Used if the target is not run by BinaryExecutorCoverage */
+static uint8_t LocalCounters[kNumPCs];
 
-static void exit_hook(void) {
-    char* filename = getenv("FUZZER_COUNTER_DUMP_FILE");
-    printf("exit hook: filename is %s\n", filename);
-    if ( filename != nullptr ) {
-        FILE* fp = fopen(filename, "wb");
-        if ( fp != nullptr ) {
-            fwrite(Counters, kNumPCs, 1, fp);
-            fclose(fp);
-        }
+/* Points to the region shared with the server. Coverage written here is
+ * visible to the server immediately, so it survives crashes and _exit.
+ */
+static uint8_t* Counters = LocalCounters;
+static size_t NumCounters = kNumPCs;
+
+/* Maps the region whose file descriptor is in the environment variable
+ * name, inherited from the server. If size is 0, maps all of it and sets
+ * size. Returns nullptr if name is not set.
+ */
+static void* map_from_env(const char* name, size_t& size, const int prot) {
+    const char* fdStr = getenv(name);
+    if ( fdStr == nullptr ) {
+        return nullptr;
+    }
+
+    const int fd = atoi(fdStr);
+    struct stat st;
+    if ( fstat(fd, &st) != 0 || st.st_size <= 0 || static_cast<size_t>(st.st_size) < size ) {
+        abort();
+    }
+    if ( size == 0 ) {
+        size = st.st_size;
     }
+
+    void* p = mmap(nullptr, size, prot, MAP_SHARED, fd, 0);
+    if ( p == MAP_FAILED ) {
+        abort();
+    }
+
+    return p;
 }
 
-class Init {
-    public:
-        Init(void) {
-            if ( atexit(exit_hook) != 0 ) {
-                abort();
-            }
+static void map_counters(void) {
+    /* The server may be built with another kNumPCs */
+    size_t size = 0;
+    void* p = map_from_env(kCounterFdEnv, size, PROT_READ | PROT_WRITE);
+    if ( p == nullptr ) {
+        return;
+    }
+
+    Counters = static_cast<uint8_t*>(p);
+    NumCounters = size;
+}
+
+#if defined(FUZZING_AUTODICTIONARY_HOOKS)
+/* Comparison operands then go to the server instead of this process */
+static void map_autodictionary(void) {
+    using fuzzing::dictionary::AutoDictionary;
+
+    size_t size = sizeof(AutoDictionary::Table);
+    void* p = map_from_env(kAutoDictionaryFdEnv, size, PROT_READ | PROT_WRITE);
+    if ( p == nullptr ) {
+        return;
+    }
+
+    fuzzing::dictionary::autoDictionaryTable = static_cast<AutoDictionary::Table*>(p);
+}
+#endif
+
+/* Maps the input region on first use */
+static const uint8_t* Input = nullptr;
+
+extern "C" size_t FuzzerGetInput(const uint8_t** data) {
+    if ( Input == nullptr ) {
+        size_t size = sizeof(uint32_t) + kMaxInputSize;
+        Input = static_cast<const uint8_t*>(map_from_env(kInputFdEnv, size, PROT_READ));
+        if ( Input == nullptr ) {
+            *data = nullptr;
+            return 0;
         }
-};
+    }
 
-static Init init;
+    uint32_t size;
+    memcpy(&size, Input, sizeof(size));
+    *data = Input + sizeof(size);
 
+    return size;
+}
+
+/* Set in forkserver children */
+static bool Forked = false;
+
+extern "C" int FuzzerLoop(const unsigned int n) {
+    static unsigned int iteration = 0;
+
+    if ( iteration == 0 ) {
+        iteration++;
+        return 1;
+    }
+
+    if ( Forked == false || iteration >= n ) {
+        return 0;
+    }
+
+    /* Tell the forkserver this run is done, and wait for the next */
+    raise(SIGSTOP);
+
+    iteration++;
+    return 1;
+}
+
+/* Runs from the module constructors, before any guard can fire */
 extern "C" void __sanitizer_cov_trace_pc_guard_init(uint32_t *start, uint32_t *stop) {
+    if ( Counters == LocalCounters ) {
+        map_counters();
+#if defined(FUZZING_AUTODICTIONARY_HOOKS)
+        map_autodictionary();
+#endif
+    }
+
     if (start == stop || *start) return;
     size_t NumGuards = 0;
     for (uint32_t *x = start; x < stop; x++) {
         NumGuards++;
-        *x = NumGuards % kNumPCs;
+        *x = NumGuards % NumCounters;
+    }
+}
+
+static bool read_all(const int fd, void* data, size_t size) {
+    uint8_t* p = static_cast<uint8_t*>(data);
+
+    while ( size > 0 ) {
+        const auto ret = read(fd, p, size);
+        if ( ret <= 0 ) {
+            return false;
+        }
+        p += ret;
+        size -= ret;
+    }
+
+    return true;
+}
+
+/* Arguments of the current run, see util::ForkServer */
+static std::string RunArgs;
+static std::vector<char*> RunArgv;
+
+/* Forkserver loop, see util::ForkServer. Returns only in a child, which
+ * then proceeds to main. If withArgs, the child's arguments are replaced
+ * with those of the run.
+ *
+ * A child in persistent mode stops itself after each run. It is resumed
+ * for the next run instead of forking a new one, unless the arguments
+ * changed.
+ */
+static void fork_server(const bool withArgs, int& argc, char**& argv) {
+    using fuzzing::util::ForkServer;
+
+    if ( getenv(ForkServer::kForkServerEnv) == nullptr ) {
+        return;
     }
+    /* Programs started by the target are not forkservers */
+    unsetenv(ForkServer::kForkServerEnv);
+
+    uint32_t msg = withArgs ? ForkServer::kHelloArgs : 0;
+    if ( write(ForkServer::kStatusFd, &msg, sizeof(msg)) != sizeof(msg) ) {
+        return;
+    }
+
+    /* Stopped persistent-mode child and its arguments, or -1 */
+    pid_t child = -1;
+    uint32_t childMsg = 0;
+    std::string childArgs;
+    std::string args;
+
+    while ( true ) {
+        if ( read_all(ForkServer::kControlFd, &msg, sizeof(msg)) == false ) {
+            _exit(0);
+        }
+
+        args.clear();
+        if ( msg != ForkServer::kKeepArgs ) {
+            args.resize(msg);
+            if ( read_all(ForkServer::kControlFd, &args[0], msg) == false ) {
+                _exit(0);
+            }
+        }
+
+        if ( child != -1 && (msg != childMsg || args != childArgs) ) {
+            kill(child, SIGKILL);
+            waitpid(child, nullptr, 0);
+            child = -1;
+        }
+
+        if ( child != -1 ) {
+            kill(child, SIGCONT);
+        } else {
+            child = fork();
+            if ( child == -1 ) {
+                _exit(1);
+            }
+
+            if ( child == 0 ) {
+                close(ForkServer::kControlFd);
+                close(ForkServer::kStatusFd);
+                Forked = true;
+
+                if ( msg != ForkServer::kKeepArgs ) {
+                    RunArgs = args;
+                    RunArgv.push_back(argv[0]);
+                    for (size_t i = 0; i < RunArgs.size(); i = RunArgs.find('\0', i) + 1) {
+                        RunArgv.push_back(&RunArgs[i]);
+                    }
+                    RunArgv.push_back(nullptr);
+                    argc = RunArgv.size() - 1;
+                    argv = RunArgv.data();
+                }
+
+                return;
+            }
+            childMsg = msg;
+            childArgs = args;
+        }
+
+        int32_t status = child;
+        if ( write(ForkServer::kStatusFd, &status, sizeof(status)) != sizeof(status) ) {
+            _exit(0);
+        }
+
+        if ( waitpid(child, &status, WUNTRACED) == -1 ) {
+            _exit(1);
+        }
+
+        if ( !WIFSTOPPED(status) ) {
+            child = -1;
+        }
+
+        if ( write(ForkServer::kStatusFd, &status, sizeof(status)) != sizeof(status) ) {
+            _exit(0);
+        }
+    }
+}
+
+/* Defined if the target is linked with -Wl,--wrap=main. Then the
+ * forkserver runs from __wrap_main, after all static initializers, and
+ * runs can have their own arguments.
+ */
+extern "C" int __real_main(int argc, char** argv, char** envp) __attribute__((weak));
+
+extern "C" int __wrap_main(int argc, char** argv, char** envp) {
+    fork_server(true, argc, argv);
+
+    return __real_main(argc, argv, envp);
+}
+
+/* Otherwise the forkserver runs from here, and children keep the
+ * arguments the target was started with. Initializers of shared
+ * libraries run before it. Among the initializers of the executable the
+ * order depends on the link order: those that run after this one run
+ * again in every child. A priority cannot help, since initializers
+ * without one run last.
+ */
+__attribute__((constructor)) static void fork_server_constructor(int argc, char** argv) {
+    if ( __real_main != nullptr ) {
+        return;
+    }
+
+    fork_server(false, argc, argv);
 }
 
 extern "C" void __sanitizer_cov_trace_pc_guard(uint32_t *guard) {
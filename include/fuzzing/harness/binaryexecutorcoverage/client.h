@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* API for targets linked with client.cpp.
+ *
+ * Persistent mode: instead of forking a new process per run, the
+ * forkserver child handles up to n runs in a loop:
+ *
+ *   int main(void) {
+ *       init();
+ *       while ( FUZZER_LOOP(1000) ) {
+ *           const uint8_t* data;
+ *           const size_t size = FuzzerGetInput(&data);
+ *           process(data, size);
+ *       }
+ *   }
+ *
+ * The child is replaced after n runs or when it crashes. Without a
+ * forkserver the loop body runs once.
+ *
+ * Link the target with -Wl,--wrap=main to let every run have its own
+ * arguments. Otherwise the forkserver only reruns the arguments the
+ * target was started with, and other runs start the target directly.
+ */
+
+#define FUZZER_LOOP(n) FuzzerLoop(n)
+
+extern "C" {
+    int FuzzerLoop(const unsigned int n);
+
+    /* Input set with BinaryExecutorCoverage::SetInput. size is 0 if
+     * there is none.
+     */
+    size_t FuzzerGetInput(const uint8_t** data);
+}
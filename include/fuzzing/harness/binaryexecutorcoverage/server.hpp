@@ -1,12 +1,20 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <string>
+#include <fuzzing/dictionary/autodictionary.h>
 #include <fuzzing/util/binaryexecutor.hpp>
 #include "shared.hpp"
 
+/* Aligned so the shared coverage region can be mapped over it. kNumPCs
+ * is a multiple of it, so no other data shares the mapped pages.
+ */
+static const size_t kCountersAlignment = 1 << 16;
+static_assert(kNumPCs % kCountersAlignment == 0, "kNumPCs must be a multiple of kCountersAlignment");
+
 extern "C" {
-    __attribute__((section("__libfuzzer_extra_counters")))
+    __attribute__((section("__libfuzzer_extra_counters"), aligned(kCountersAlignment)))
     static uint8_t Counters[kNumPCs];
 }
 
@@ -16,59 +24,114 @@ namespace binaryexecutorcoverage {
 
 class BinaryExecutorCoverage : public util::BinaryExecutor {
     private:
-        const std::string pidStr;
-        size_t counter = 0;
-        std::string lastDumpfile;
-
-        std::string getDumpfile(void) {
-            counter++;
-            const std::string ret = "COUNTER_DUMPFILE_" + pidStr + "_" + std::to_string(counter);
-            lastDumpfile = ret;
-            return ret;
-        }
+        /* Creates a memfd of size bytes, maps it (over addr if not
+         * nullptr) and publishes its file descriptor to child processes
+         * in the environment variable envVar.
+         */
+        static void* mapShared(const char* name, const size_t size, const char* envVar, void* addr = nullptr) {
+            const int fd = memfd_create(name, 0);
+            if ( fd == -1 ) {
+                abort();
+            }
 
-    public:
-        BinaryExecutorCoverage(const std::string program) :
-            util::BinaryExecutor(program), pidStr( std::to_string(getpid()) )
-        { }
+            if ( ftruncate(fd, size) != 0 ) {
+                abort();
+            }
 
-        bool preExecHook(void) override {
-            const auto dumpfile = getDumpfile();
-            /* TODO check ret */ unlink(dumpfile.c_str());
+            void* p = mmap(addr, size, PROT_READ | PROT_WRITE, MAP_SHARED | (addr ? MAP_FIXED : 0), fd, 0);
+            if ( p == MAP_FAILED ) {
+                abort();
+            }
 
-            if ( setenv("FUZZER_COUNTER_DUMP_FILE", dumpfile.c_str(), 1) != 0 ) {
+            if ( setenv(envVar, std::to_string(fd).c_str(), 1) != 0 ) {
                 abort();
             }
 
-            return true;
+            return p;
         }
 
-        bool postExecHook(const int systemRet) override {
-            /* TODO remove dumpfile */
+        /* Replaces Counters with a memfd mapping that child processes
+         * inherit through kCounterFdEnv. Clients then write straight into
+         * the extra-counters section, so nothing is copied after a run.
+         * Done once per process.
+         */
+        static void setupCounters(void) {
+            static void* counters = mapShared("fuzzer-counters", kNumPCs, kCounterFdEnv, Counters);
+            (void)counters;
+        }
 
-            if ( systemRet != 0 ) {
-                return false;
-            }
+        /* Input region shared with the clients, see FuzzerGetInput */
+        static uint8_t* getInput(void) {
+            static uint8_t* input = static_cast<uint8_t*>(
+                    mapShared("fuzzer-input", sizeof(uint32_t) + kMaxInputSize, kInputFdEnv));
+
+            return input;
+        }
 
-            const auto dumpfile = lastDumpfile;
-            FILE* fp = fopen(dumpfile.c_str(), "rb");
-            if ( fp == nullptr ) {
+        /* Comparison operands captured by clients built with
+         * FUZZING_AUTODICTIONARY_HOOKS, shared through kAutoDictionaryFdEnv
+         */
+        static dictionary::AutoDictionary& getAutoDictionary(void) {
+            static dictionary::AutoDictionary autoDictionary(static_cast<dictionary::AutoDictionary::Table*>(
+                    mapShared("fuzzer-autodictionary", sizeof(dictionary::AutoDictionary::Table), kAutoDictionaryFdEnv)));
+
+            return autoDictionary;
+        }
+
+    public:
+        BinaryExecutorCoverage(const std::string program) :
+            util::BinaryExecutor(program)
+        {
+            setupCounters();
+            getInput();
+            getAutoDictionary();
+        }
+
+        BinaryExecutorCoverage(const std::vector<std::string> argv, const Environment env = {}) :
+            util::BinaryExecutor(argv, env)
+        {
+            setupCounters();
+            getInput();
+            getAutoDictionary();
+        }
+
+        /* Input for the next runs of clients that call FuzzerGetInput.
+         * Returns false if size exceeds kMaxInputSize.
+         */
+        static bool SetInput(const uint8_t* data, const size_t size) {
+            if ( size > kMaxInputSize ) {
                 return false;
             }
 
-            bool ret = false;
-            uint8_t _Counters[kNumPCs];
-            if ( fread(_Counters, kNumPCs, 1, fp) != 1 ) {
-                goto end;
+            uint8_t* input = getInput();
+            const uint32_t size32 = size;
+            memcpy(input, &size32, sizeof(size32));
+            if ( size ) {
+                memcpy(input + sizeof(size32), data, size);
             }
 
-            memcpy(Counters, _Counters, kNumPCs);
+            return true;
+        }
+
+        /* Receives the comparison operands of the clients after every
+         * Run(), e.g. for datasource::Mutator::AddSource(GetAutoDictionary()).
+         * Flushed on the thread that calls Run(); mutators on other threads
+         * may read it meanwhile.
+         */
+        static std::shared_ptr<dictionary::Dictionary> GetAutoDictionary(void) {
+            return getAutoDictionary().Get();
+        }
 
-            ret = true;
-end:
-            fclose(fp);
+        /* Targets are linked with the client, which implements it */
+        bool useForkServer(void) const override {
+            return true;
+        }
+
+        bool postExecHook(const int systemRet) override {
+            getAutoDictionary().Flush();
 
-            return ret;
+            /* Coverage is already in Counters, even if the target crashed */
+            return systemRet == 0;
         }
 
 };
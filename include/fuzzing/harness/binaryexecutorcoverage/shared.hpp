@@ -1 +1,31 @@
+/* Number of coverage counters. libFuzzer clears and scans all of them
+ * on every run, so builds whose targets have fewer guards can define
+ * FUZZING_BINARYEXECUTORCOVERAGE_NUM_PCS to about their number of guards.
+ * Guards beyond it share counters. Only the server needs it; clients use
+ * the size of the region they map.
+ *
+ * Rounded up to 64 KiB, because the server maps the shared region over
+ * its counters in whole pages.
+ */
+#if defined(FUZZING_BINARYEXECUTORCOVERAGE_NUM_PCS)
+static const size_t kNumPCs = (FUZZING_BINARYEXECUTORCOVERAGE_NUM_PCS + 0xFFFF) & ~static_cast<size_t>(0xFFFF);
+#else
 static const size_t kNumPCs = 1 << 21;
+#endif
+
+/* Environment variable holding the file descriptor of the shared
+ * coverage region (kNumPCs bytes), inherited from the server.
+ */
+static const char* const kCounterFdEnv = "FUZZER_COUNTER_FD";
+
+/* Environment variable holding the file descriptor of the shared input
+ * region: a uint32_t size followed by up to kMaxInputSize bytes.
+ */
+static const char* const kInputFdEnv = "FUZZER_INPUT_FD";
+static const size_t kMaxInputSize = 1 << 20;
+
+/* Environment variable holding the file descriptor of the shared
+ * dictionary::AutoDictionary::Table, for clients built with
+ * FUZZING_AUTODICTIONARY_HOOKS.
+ */
+static const char* const kAutoDictionaryFdEnv = "FUZZER_AUTODICTIONARY_FD";
@@ -2,9 +2,14 @@
 
 #include <fuzzing/dictionary/dictionary.h>
 
+#include <atomic>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <string.h>
 #include <vector>
 
 extern "C" size_t LLVMFuzzerMutate(uint8_t* data, size_t size, size_t maxSize);
@@ -22,7 +27,20 @@ class Base {
 
         virtual size_t Mutate(uint8_t* data, size_t size, const size_t maxSize) = 0;
 
+        /* Combine two inputs into out. Returns the size of the result, or 0
+         * if this mutator does not support crossover or failed to produce
+         * a child.
+         */
+        virtual size_t CrossOver(const uint8_t* data1, const size_t size1, const uint8_t* data2, const size_t size2, uint8_t* out, const size_t maxOutSize) {
+            (void)data1; (void)size1; (void)data2; (void)size2; (void)out; (void)maxOutSize;
+            return 0;
+        }
+
         void AddSource(std::shared_ptr<::fuzzing::dictionary::Dictionary> d);
+
+        void Seed(const uint64_t seed) {
+            rand.Seed(seed);
+        }
 };
         
 #ifndef FUZZING_HEADERS_NO_IMPL
@@ -31,9 +49,237 @@ void Base::AddSource(std::shared_ptr<::fuzzing::dictionary::Dictionary> d) {
 }
 #endif
 
+/* Chooses which mutator to run with UCB1, a multi-armed bandit.
+ *
+ * An arm is rewarded when one of its outputs enters the corpus. libFuzzer
+ * does not report this directly, but it passes corpus inputs back into
+ * the custom mutator. So the hashes of recent outputs are remembered, and
+ * an input that matches one of them is credited to the arm that made it.
+ * libFuzzer also feeds the previous output straight back in when it
+ * stacks several mutations; that input is not credited.
+ */
+class Scheduler {
+    public:
+        struct Arm {
+            /* Number of times this arm was run */
+            uint64_t hits = 0;
+            /* Number of its outputs that were later seen as inputs */
+            uint64_t yield = 0;
+        };
+    private:
+        static const size_t kNumOutputs = 1 << 16;
+
+        struct Output {
+            uint64_t hash;
+            /* Arm index + 1, or 0 if unused */
+            size_t arm;
+        };
+
+        std::vector<Arm> arms;
+        std::vector<Output> outputs;
+        uint64_t totalHits = 0;
+        uint64_t lastInput = 0;
+        uint64_t lastOutput = 0;
+        const double exploration;
+
+        static uint64_t hash(const uint8_t* data, const size_t size);
+    public:
+        /* Higher exploration spreads runs more evenly across the arms */
+        Scheduler(const double exploration = 1.0);
+
+        /* Called with each input before mutating it. Credits the arm
+         * that produced data, if any.
+         */
+        void Received(const uint8_t* data, const size_t size);
+
+        /* Pick one of numArms arms */
+        size_t Select(const size_t numArms);
+
+        /* Remember that arm produced data */
+        void Produced(const size_t arm, const uint8_t* data, const size_t size);
+
+        const std::vector<Arm>& Arms(void) const {
+            return arms;
+        }
+};
+
 #ifndef FUZZING_HEADERS_NO_IMPL
-::fuzzing::util::Random rand;
-std::vector< std::unique_ptr<Base> > mutators;
+Scheduler::Scheduler(const double exploration) :
+    outputs(kNumOutputs, {0, 0}), exploration(exploration)
+{ }
+
+uint64_t Scheduler::hash(const uint8_t* data, const size_t size) {
+    /* FNV-1a */
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; i++) {
+        h ^= data[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+void Scheduler::Received(const uint8_t* data, const size_t size) {
+    const uint64_t h = hash(data, size);
+    lastInput = h;
+
+    if ( totalHits != 0 && h == lastOutput ) {
+        return;
+    }
+
+    auto& output = outputs[h % kNumOutputs];
+
+    if ( output.arm != 0 && output.hash == h ) {
+        if ( output.arm <= arms.size() ) {
+            arms[output.arm - 1].yield++;
+        }
+        /* Credit each output once */
+        output.arm = 0;
+    }
+}
+
+size_t Scheduler::Select(const size_t numArms) {
+    if ( arms.size() < numArms ) {
+        arms.resize(numArms);
+    }
+
+    /* Yield rates are tiny, so normalize them to the best arm; otherwise
+     * the exploration term always dominates.
+     */
+    double maxRate = 0;
+    for (size_t i = 0; i < numArms; i++) {
+        if ( arms[i].hits == 0 ) {
+            return i;
+        }
+        const double rate = static_cast<double>(arms[i].yield) / arms[i].hits;
+        if ( rate > maxRate ) {
+            maxRate = rate;
+        }
+    }
+
+    const double logTotal = std::log(static_cast<double>(totalHits));
+
+    size_t best = 0;
+    double bestScore = -1;
+    for (size_t i = 0; i < numArms; i++) {
+        const double rate = static_cast<double>(arms[i].yield) / arms[i].hits;
+        const double score =
+            (maxRate > 0 ? rate / maxRate : 0) +
+            exploration * std::sqrt(2 * logTotal / arms[i].hits);
+        if ( score > bestScore ) {
+            best = i;
+            bestScore = score;
+        }
+    }
+
+    return best;
+}
+
+void Scheduler::Produced(const size_t arm, const uint8_t* data, const size_t size) {
+    arms[arm].hits++;
+    totalHits++;
+
+    const uint64_t h = hash(data, size);
+    lastOutput = h;
+
+    /* An unchanged input would take the credit of whatever made it */
+    if ( h == lastInput ) {
+        return;
+    }
+
+    outputs[h % kNumOutputs] = {h, arm + 1};
+}
+#endif
+
+/* Mutators are not thread-safe, so each thread that runs the custom
+ * mutator gets its own instances, created from factories registered
+ * here. Register all factories before fuzzing starts; a thread picks up
+ * factories registered later on its next call.
+ */
+using Factory = std::function<std::unique_ptr<Base>(void)>;
+
+class Registry {
+    private:
+        std::mutex mutex;
+        std::vector<Factory> factories;
+        std::atomic<size_t> size{0};
+    public:
+        void Add(Factory factory);
+
+        size_t Size(void) const {
+            return size.load(std::memory_order_acquire);
+        }
+
+        /* Append instances for the factories beyond mutators.size() */
+        void Instantiate(std::vector< std::unique_ptr<Base> >& mutators);
+};
+
+/* Per-thread state of the custom mutator */
+struct ThreadState {
+    std::vector< std::unique_ptr<Base> > mutators;
+    /* Arm 0 is LLVMFuzzerMutate, arm i + 1 is mutators[i] */
+    Scheduler scheduler;
+    /* Whether the generators were seeded from libFuzzer */
+    bool seeded = false;
+};
+
+#ifndef FUZZING_HEADERS_NO_IMPL
+void Registry::Add(Factory factory) {
+    std::lock_guard<std::mutex> lock(mutex);
+    factories.push_back(std::move(factory));
+    size.store(factories.size(), std::memory_order_release);
+}
+
+void Registry::Instantiate(std::vector< std::unique_ptr<Base> >& mutators) {
+    std::lock_guard<std::mutex> lock(mutex);
+    while ( mutators.size() < factories.size() ) {
+        mutators.push_back(factories[mutators.size()]());
+    }
+}
+
+Registry registry;
+
+/* Independently seeded in each thread */
+thread_local ::fuzzing::util::Random rand;
+thread_local ThreadState threadState;
+
+/* Only takes the registry lock if a factory was added since the last
+ * call on this thread. New mutators are seeded from rand.
+ */
+ThreadState& GetThreadState(void) {
+    auto& mutators = threadState.mutators;
+
+    if ( mutators.size() != registry.Size() ) {
+        const size_t first = mutators.size();
+        registry.Instantiate(mutators);
+        for (size_t i = first; i < mutators.size(); i++) {
+            mutators[i]->Seed(rand());
+        }
+    }
+
+    return threadState;
+}
+
+/* As above, but on first use the thread's generators are seeded from
+ * the seed libFuzzer passes in, so that runs with the same -seed make
+ * the same choices.
+ */
+ThreadState& GetThreadState(const unsigned int seed) {
+    auto& state = GetThreadState();
+
+    if ( state.seeded == false ) {
+        rand.Seed(seed);
+        for (auto& mutator : state.mutators) {
+            mutator->Seed(rand());
+        }
+        state.seeded = true;
+    }
+
+    return state;
+}
+
+void Register(Factory factory) {
+    registry.Add(std::move(factory));
+}
 #endif
 
 } /* namespace mutator */
@@ -41,17 +287,51 @@ std::vector< std::unique_ptr<Base> > mutators;
 
 #ifndef FUZZING_HEADERS_NO_IMPL
 extern "C" size_t LLVMFuzzerCustomMutator(uint8_t* data, size_t size, size_t maxSize, unsigned int seed) {
-    const bool runCustomMutator = seed & 1;
-    seed >>= 1;
+    auto& state = fuzzing::mutator::GetThreadState(seed);
+    auto& scheduler = state.scheduler;
+
+    scheduler.Received(data, size);
 
-    size = LLVMFuzzerMutate(data, size, maxSize);
-    if ( !fuzzing::mutator::mutators.empty() && runCustomMutator) {
-        const size_t mutatorIndex = seed % fuzzing::mutator::mutators.size();
-        size = fuzzing::mutator::mutators[mutatorIndex]->Mutate(data, size, maxSize);
+    const size_t arm = scheduler.Select(state.mutators.size() + 1);
+    if ( arm == 0 ) {
+        size = LLVMFuzzerMutate(data, size, maxSize);
+    } else {
+        size = state.mutators[arm - 1]->Mutate(data, size, maxSize);
     }
 
+    scheduler.Produced(arm, data, size);
+
     return size;
+}
 
+extern "C" size_t LLVMFuzzerCustomCrossOver(const uint8_t* data1, size_t size1, const uint8_t* data2, size_t size2, uint8_t* out, size_t maxOutSize, unsigned int seed) {
+    auto& mutators = fuzzing::mutator::GetThreadState(seed).mutators;
+    const size_t numMutators = mutators.size();
+
+    /* Let the first mutator that understands the input format do it */
+    for (size_t i = 0; i < numMutators; i++) {
+        const size_t mutatorIndex = (seed + i) % numMutators;
+        const size_t size = mutators[mutatorIndex]->CrossOver(data1, size1, data2, size2, out, maxOutSize);
+        if ( size != 0 ) {
+            return size;
+        }
+    }
+
+    /* Fall back to splicing a prefix of data1 onto a suffix of data2 */
+    const size_t prefixSize = fuzzing::mutator::rand.Get(size1 + 1);
+    const size_t suffixSize = fuzzing::mutator::rand.Get(size2 + 1);
+
+    size_t size = 0;
+    if ( prefixSize ) {
+        size = prefixSize < maxOutSize ? prefixSize : maxOutSize;
+        memcpy(out, data1, size);
+    }
+    if ( suffixSize && size < maxOutSize ) {
+        const size_t n = suffixSize < maxOutSize - size ? suffixSize : maxOutSize - size;
+        memcpy(out + size, data2 + size2 - suffixSize, n);
+        size += n;
+    }
+
+    return size;
 }
 #endif
-
@@ -7,44 +7,45 @@
 
 namespace fuzzing {
 
-class SingleTest {
+template <class DatasourceType>
+class BasicSingleTest {
     private:
-        std::function<void(datasource::Datasource& ds)> fn;
+        std::function<void(DatasourceType& ds)> fn;
     public:
-        SingleTest(std::function<void(datasource::Datasource& ds)> fn) : fn(fn) { }
-        void Test(datasource::Datasource& ds) const {
+        BasicSingleTest(std::function<void(DatasourceType& ds)> fn) : fn(fn) { }
+        void Test(DatasourceType& ds) const {
             fn(ds);
         }
 };
 
-class Multitest {
+template <class DatasourceType>
+class BasicMultitest {
     private:
-        std::vector<SingleTest> tests;
+        std::vector<BasicSingleTest<DatasourceType>> tests;
         const size_t numTests;
         const uint64_t id;
 
     public:
-        Multitest(std::initializer_list<SingleTest> tests, const uint64_t id = 0) : tests{std::move(tests)}, numTests(this->tests.size()), id(id) {}
-        void Test(datasource::Datasource& ds) const {
-            const auto which = ds.Get<uint16_t>(id);
-
+        BasicMultitest(std::initializer_list<BasicSingleTest<DatasourceType>> tests, const uint64_t id = 0) : tests{std::move(tests)}, numTests(this->tests.size()), id(id) {}
+        void Test(DatasourceType& ds) const {
             if ( numTests == 0 ) {
                 /* Abort ? */
                 return;
             }
 
-            if ( which >= numTests ) {
-                return;
-            }
+            const auto which = ds.GetIndex(numTests, id);
 
             tests[which].Test(ds);
         }
-        
-        void Loop(datasource::Datasource& ds, const size_t numLoops) const {
+
+        void Loop(DatasourceType& ds, const size_t numLoops) const {
             for (size_t i = 0; i < numLoops; i++) {
                 Test(ds);
             }
         }
 };
 
+using SingleTest = BasicSingleTest<datasource::Datasource>;
+using Multitest = BasicMultitest<datasource::Datasource>;
+
 } /* namespace fuzzing */
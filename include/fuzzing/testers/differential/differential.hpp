@@ -6,24 +6,40 @@
 #include <optional>
 #include <functional>
 #include <string>
+#include <type_traits>
 #include <utility>
 
 namespace fuzzing {
 namespace testers {
 namespace differential {
 
+/* Inputs that only implement Load() can be read from a Datasource.
+ * To be read from any datasource (e.g. StaticDatasource), implement
+ *
+ *   template <class DatasourceType> void LoadFrom(DatasourceType& ds);
+ *
+ * instead, most easily by deriving from UniversalGeneric.
+ */
 struct UniversalBase {
     virtual void Load(datasource::Datasource& ds) = 0;
     virtual ~UniversalBase() = default;
 };
 
+/* Implements Load() through Derived::LoadFrom() */
+template <class Derived>
+struct UniversalGeneric : public UniversalBase {
+    void Load(datasource::Datasource& ds) override {
+        static_cast<Derived*>(this)->LoadFrom(ds);
+    }
+};
+
 template <class T>
-struct UniversalFromGeneric : public UniversalBase {
+struct UniversalFromGeneric : public UniversalGeneric<UniversalFromGeneric<T>> {
     T v;
     UniversalFromGeneric(void) = default;
     UniversalFromGeneric(T v) : v(v) { }
-    void Load(datasource::Datasource& ds) override {
-        v = ds.Get<T>();
+    template <class DatasourceType> void LoadFrom(DatasourceType& ds) {
+        v = ds.template Get<T>();
     }
     bool operator!=(const UniversalFromGeneric<T>& other) const {
         return v != other.v;
@@ -88,12 +104,30 @@ using DifferentialTargetDefaultSingle = DifferentialTargetDefault<InternalInput,
 template <typename InternalInput, typename UniversalInput, typename UniversalOutput>
 using DifferentialTargetDefaultMulti = DifferentialTargetDefault<InternalInput, UniversalInput, UniversalOutput, true>;
 
+template <class UniversalInput, class DatasourceType, class = void>
+struct HasLoadFrom : std::false_type { };
+
+template <class UniversalInput, class DatasourceType>
+struct HasLoadFrom<UniversalInput, DatasourceType,
+    std::void_t<decltype(std::declval<UniversalInput&>().LoadFrom(std::declval<DatasourceType&>()))>> : std::true_type { };
+
 template <typename UniversalInput, typename UniversalOutput, bool Multi, class... Targets>
 class DifferentialTester {
     using UniversalOutputExtra = DifferentialReturn<UniversalOutput, Multi>;
     static_assert(std::is_base_of<UniversalBase, UniversalInput>::value);
     static_assert(std::is_base_of<UniversalBase, UniversalOutput>::value);
     protected:
+        template <class DatasourceType>
+        static void load(UniversalInput& input, DatasourceType& ds) {
+            if constexpr ( HasLoadFrom<UniversalInput, DatasourceType>::value ) {
+                input.LoadFrom(ds);
+            } else {
+                static_assert(std::is_convertible<DatasourceType&, datasource::Datasource&>::value,
+                        "UniversalInput must implement LoadFrom() to be read from this datasource");
+                input.Load(ds);
+            }
+        }
+
         template<std::size_t I = 0, typename... Tp> inline typename std::enable_if<I == sizeof...(Tp), void>::type RunTarget(
                 const UniversalInput& input,
                 std::vector<UniversalOutputExtra>& results,
@@ -123,14 +157,15 @@ class DifferentialTester {
         DifferentialTester(void) = default;
         ~DifferentialTester(void) = default;
 
-        bool Run(datasource::Datasource& ds) {
+        template <class DatasourceType>
+        bool Run(DatasourceType& ds) {
             /* Instantiate each target class */
             std::tuple<Targets...> targets;
 
             constexpr size_t numTargets = std::tuple_size<decltype(targets)>::value;
 
             UniversalInput input;
-            input.Load(ds);
+            load(input, ds);
 
             do {
                 std::vector<UniversalOutputExtra> results(numTargets);
@@ -6,20 +6,23 @@
 #include <fuzzing/exception.hpp>
 #include <fuzzing/util/binaryexecutor.hpp>
 #include <stdlib.h>
+#include <string>
+#include <vector>
 
 namespace fuzzing {
 namespace testers {
 namespace filesystem {
 
-class FilesystemTester {
+template <class DatasourceType>
+class BasicFilesystemTester {
     protected:
-        datasource::Datasource& ds;
+        DatasourceType& ds;
         const std::string fsRootPath;
         virtual bool transform(void) = 0;
     private:
         const fuzzing::generators::filesystem::Filesystem fs;
     public:
-        FilesystemTester(datasource::Datasource& ds, const std::string fsRootPath) :
+        BasicFilesystemTester(DatasourceType& ds, const std::string fsRootPath) :
             ds(ds), fsRootPath(fsRootPath), fs(ds, fsRootPath)
         { }
 
@@ -60,8 +63,10 @@ class FilesystemTester {
         }
 };
 
-class ArchiverTester : public FilesystemTester {
+template <class DatasourceType>
+class BasicArchiverTester : public BasicFilesystemTester<DatasourceType> {
     protected:
+        using BasicFilesystemTester<DatasourceType>::fsRootPath;
         virtual bool pack(const std::string infile, const std::string outfile) = 0;
         virtual bool unpack(const std::string infile) = 0;
     private:
@@ -98,66 +103,72 @@ class ArchiverTester : public FilesystemTester {
             return true;
         }
     public:
-        ArchiverTester(fuzzing::datasource::Datasource& ds, const std::string fsRootPath) :
-            FilesystemTester(ds, fsRootPath)
+        BasicArchiverTester(DatasourceType& ds, const std::string fsRootPath) :
+            BasicFilesystemTester<DatasourceType>(ds, fsRootPath)
         { }
 };
 
-template <typename BinaryExecutor>
-class TarTester : public ArchiverTester {
+using FilesystemTester = BasicFilesystemTester<datasource::Datasource>;
+using ArchiverTester = BasicArchiverTester<datasource::Datasource>;
+
+template <typename BinaryExecutor, class DatasourceType = datasource::Datasource>
+class TarTester : public BasicArchiverTester<DatasourceType> {
     static_assert(std::is_base_of<util::BinaryExecutor, BinaryExecutor>::value);
     private:
         const std::string tarCmd;
-        std::string extraFlags;
+        std::vector<std::string> extraFlags;
 
-        bool pack(const std::string infile, const std::string outfile) override {
-            const auto cmd = std::string(tarCmd + " " + extraFlags + " --create --file " + outfile + " " + infile);
+        std::vector<std::string> getArgv(const std::vector<std::string> args) const {
+            std::vector<std::string> ret{tarCmd};
+            ret.insert(ret.end(), extraFlags.begin(), extraFlags.end());
+            ret.insert(ret.end(), args.begin(), args.end());
+            return ret;
+        }
 
-            BinaryExecutor executor(cmd);
+        bool pack(const std::string infile, const std::string outfile) override {
+            BinaryExecutor executor(getArgv({"--create", "--file", outfile, infile}));
             return executor.Run();
         }
 
         bool unpack(const std::string infile) override {
-            const auto cmd = std::string(tarCmd + " " + extraFlags + " --extract --file " + infile);
-
-            BinaryExecutor executor(cmd);
+            BinaryExecutor executor(getArgv({"--extract", "--file", infile}));
             return executor.Run();
         }
     public:
         TarTester(
-                fuzzing::datasource::Datasource& ds,
+                DatasourceType& ds,
                 const std::string fsRootPath,
                 const std::string tarCmd) :
-            ArchiverTester(ds, fsRootPath),
+            BasicArchiverTester<DatasourceType>(ds, fsRootPath),
             tarCmd(tarCmd.empty() ? "tar" : tarCmd)
         {
-            const auto compression = ds.Get<uint8_t>();
+            const auto compression = ds.template Get<uint8_t>();
 
             switch ( compression ) {
                 case    1:
-                    extraFlags += "--gzip ";
+                    extraFlags.push_back("--gzip");
                     break;
                 case    2:
-                    extraFlags += "--bzip2 ";
+                    extraFlags.push_back("--bzip2");
                     break;
                 case    3:
-                    extraFlags += "--xz ";
+                    extraFlags.push_back("--xz");
                     break;
                 case    4:
-                    extraFlags += "--lzip ";
+                    extraFlags.push_back("--lzip");
                     break;
                 case    5:
-                    extraFlags += "--lzma ";
+                    extraFlags.push_back("--lzma");
                     break;
                 case    6:
-                    extraFlags += "--lzop ";
+                    extraFlags.push_back("--lzop");
                     break;
             }
 
             {
                 std::string sortArg = "--sort=";
 
-                const auto sort = ds.Get<uint8_t>();
+                const auto sort = ds.template Get<uint8_t>();
 
                 switch ( sort ) {
                     case    1:
@@ -171,19 +182,17 @@ class TarTester : public ArchiverTester {
                         break;
                 }
 
-                sortArg += " ";
-
-                extraFlags += sortArg;
+                extraFlags.push_back(sortArg);
             }
 
-            if ( ds.Get<bool>() == true ) {
-                extraFlags += "--seek ";
+            if ( ds.template Get<bool>() == true ) {
+                extraFlags.push_back("--seek");
             }
 
             {
                 std::string formatArg = "--format=";
 
-                const auto format = ds.Get<uint8_t>();
+                const auto format = ds.template Get<uint8_t>();
 
                 switch ( format ) {
                     case    1:
@@ -203,9 +212,7 @@ class TarTester : public ArchiverTester {
                         break;
                 }
 
-                formatArg += " ";
-
-                extraFlags += formatArg;
+                extraFlags.push_back(formatArg);
             }
         }
 };
@@ -322,7 +322,7 @@ class JsonTester : public SerializeTester<ObjectType, std::string> {
         testObjectConversionCStr(const ObjectType& input) { }
 
         ObjectType& getReference(datasource::Datasource& ds) {
-            const auto slotIdx = ds.GetChoice( datasource::ID("JsonTester.getReference.GetChoice (slot selection)") ) % 2;
+            const auto slotIdx = ds.GetIndex( 2, datasource::ID("JsonTester.getReference.GetChoice (slot selection)") );
             ObjectType& startRef = slots[slotIdx];
 
             auto ret = std::ref(startRef);
@@ -340,7 +340,7 @@ class JsonTester : public SerializeTester<ObjectType, std::string> {
                         break;
                     }
 
-                    const uint64_t whichMember = ds.Get<uint64_t>( datasource::ID("JsonTester.getReference.Get<uint64_t> (get member index)") ) % objectSize;
+                    const uint64_t whichMember = ds.GetIndex( objectSize, datasource::ID("JsonTester.getReference.Get<uint64_t> (get member index)") );
                     const auto memberName = (*memberNames)[whichMember];
 
                     const auto hasMember = jsonManipulator->HasMember(ret.get(), memberName);
@@ -356,7 +356,7 @@ class JsonTester : public SerializeTester<ObjectType, std::string> {
                         if ( !arraySize || *arraySize == 0 ) {
                             break;
                         }
-                        const uint64_t index = ds.Get<uint64_t>( datasource::ID("JsonTester.getReference.Get<uint64_t> (get array index)") ) % *arraySize;
+                        const uint64_t index = ds.GetIndex( *arraySize, datasource::ID("JsonTester.getReference.Get<uint64_t> (get array index)") );
 
                         ret = jsonManipulator->GetMemberReference(std::ref(ret.get()), index);
                     } else {
@@ -602,9 +602,9 @@ class JsonTester : public SerializeTester<ObjectType, std::string> {
             ObjectType& rootRef = root;
             std::set<ObjectType&> nodes{rootRef};
             while ( ds.Get<bool>( datasource::ID("JsonTester.construct.Get<bool> (decide to halt)") ) == true ) {
-                ObjectType& curRef = nodes[ds.Get<uint16_t>( datasource::ID("JsonTester.construct.Get<uint16_t> (node selection)") ) % nodes.size()];
+                ObjectType& curRef = nodes[ds.GetIndex( nodes.size(), datasource::ID("JsonTester.construct.Get<uint16_t> (node selection)") )];
 
-                const auto op = ds.GetChoice( datasource::ID("JsonTester.construct.Get<bool> (method choice)") );
+                const auto op = ds.GetIndex( 7, datasource::ID("JsonTester.construct.Get<bool> (method choice)") );
                 switch ( op ) {
                     case    0:
                         {
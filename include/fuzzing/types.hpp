@@ -67,6 +67,11 @@ class Container {
             return _data;
         }
 
+        const CoreType* data(void) const {
+            access_hook();
+            return _data;
+        }
+
         size_t size(void) const {
             access_hook();
             return _size;
@@ -88,6 +93,7 @@ class Container {
                 allocate_plus_1_and_copy(data, size);
                 _data[size] = 0;
             }
+            _size = size;
 
             access_hook();
         }
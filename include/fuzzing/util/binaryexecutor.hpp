@@ -1,46 +1,254 @@
 #pragma once
 
+#include <spawn.h>
 #include <stdlib.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #include <string.h>
+#include <list>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
+#include <fuzzing/util/forkserver.hpp>
+
+extern char** environ;
 
 namespace fuzzing {
 namespace util {
 
+/* Decoded wait(2) status */
+struct ExitStatus {
+    /* Set if the program ran and terminated */
+    bool valid = false;
+    bool exited = false;
+    int code = 0;
+    bool signaled = false;
+    int signal = 0;
+    bool coreDumped = false;
+
+    static ExitStatus FromWaitStatus(const int status) {
+        ExitStatus ret;
+        ret.valid = true;
+        if ( WIFEXITED(status) ) {
+            ret.exited = true;
+            ret.code = WEXITSTATUS(status);
+        } else if ( WIFSIGNALED(status) ) {
+            ret.signaled = true;
+            ret.signal = WTERMSIG(status);
+            ret.coreDumped = WCOREDUMP(status);
+        }
+        return ret;
+    }
+
+    bool Success(void) const {
+        return exited == true && code == 0;
+    }
+};
+
 class BinaryExecutor {
+    public:
+        using Environment = std::vector<std::pair<std::string, std::string>>;
+    private:
+        /* Upper bound on the number of idle forkservers kept around */
+        static const size_t kMaxForkServers = 16;
+
+        /* Forkservers are expensive to start, so they outlive the
+         * executors and are shared by all executors of the same program
+         * and environment, whatever their arguments. Most recently used
+         * first.
+         */
+        static std::list<std::pair<std::string, std::unique_ptr<ForkServer>>>& forkServers(void) {
+            static std::list<std::pair<std::string, std::unique_ptr<ForkServer>>> ret;
+            return ret;
+        }
+
+        std::unique_ptr<ForkServer> newForkServer(void) const {
+            if ( argv.empty() ) {
+                return std::make_unique<ForkServer>(program);
+            }
+            return std::make_unique<ForkServer>(argv, env);
+        }
+
+        /* Identifies program, or argv[0] and env. Arguments are sent per
+         * run, see ForkServer::Run.
+         */
+        std::string forkServerKey(void) const {
+            if ( argv.empty() ) {
+                return program;
+            }
+
+            std::string ret = argv[0];
+            ret.push_back('\0');
+            for (const auto& var : env) {
+                ret += var.first + "=" + var.second;
+                ret.push_back('\0');
+            }
+            return ret;
+        }
+
+        /* The server may not be Alive() if program does not support it */
+        ForkServer* getForkServer(void) {
+            auto& servers = forkServers();
+            const auto key = forkServerKey();
+
+            for (auto it = servers.begin(); it != servers.end(); it++) {
+                if ( it->first == key ) {
+                    servers.splice(servers.begin(), servers, it);
+                    auto& server = servers.front().second;
+                    /* Restart a server that died after it worked */
+                    if ( server->Alive() == false && server->Supported() == true ) {
+                        server = newForkServer();
+                    }
+                    return server.get();
+                }
+            }
+
+            if ( servers.size() == kMaxForkServers ) {
+                servers.pop_back();
+            }
+
+            /* Keep failed servers too, so later runs start the program
+             * directly instead of trying the protocol again.
+             */
+            servers.emplace_front(key, newForkServer());
+            return servers.front().second.get();
+        }
+
+        /* Runs argv without a shell. Returns a wait(2) status, or -1 */
+        int spawn(void) const {
+            std::vector<char*> args;
+            for (const auto& arg : argv) {
+                args.push_back(const_cast<char*>(arg.c_str()));
+            }
+            args.push_back(nullptr);
+
+            std::vector<std::string> vars;
+            std::vector<char*> envp;
+            if ( !env.empty() ) {
+                vars = MergeEnvironment(env);
+                for (auto& var : vars) {
+                    envp.push_back(const_cast<char*>(var.c_str()));
+                }
+                envp.push_back(nullptr);
+            }
+
+            pid_t pid;
+            if ( posix_spawnp(&pid, args[0], nullptr, nullptr, args.data(), env.empty() ? environ : envp.data()) != 0 ) {
+                return -1;
+            }
+
+            int status;
+            if ( waitpid(pid, &status, 0) == -1 ) {
+                return -1;
+            }
+
+            return status;
+        }
+
+        /* Runs argv through forkServer. Returns false if it cannot */
+        bool runForkServer(ForkServer* forkServer, int& status) const {
+            if ( forkServer->Alive() == false ) {
+                /* A program without forkserver support completed this
+                 * run while the server was started.
+                 */
+                return forkServer->TakeExitStatus(status);
+            }
+
+            if ( argv.empty() ) {
+                return forkServer->Run(status);
+            }
+
+            if ( forkServer->SupportsArgs() == true ) {
+                return forkServer->Run({argv.begin() + 1, argv.end()}, status);
+            }
+
+            /* The server can only rerun the arguments it was started with */
+            if ( forkServer->Argv() == argv ) {
+                return forkServer->Run(status);
+            }
+
+            return false;
+        }
+
+        int execute(void) {
+            if ( useForkServer() == true ) {
+                int status;
+                if ( runForkServer(getForkServer(), status) == true ) {
+                    return status;
+                }
+            }
+
+            if ( !argv.empty() ) {
+                return spawn();
+            }
+
+            return system(program.c_str());
+        }
+
+        ExitStatus status;
     protected:
         const std::string program;
+        const std::vector<std::string> argv;
+        const Environment env;
 
         virtual bool preExecHook(void) {
             return true;
         }
 
+        /* systemRet is in wait(2) format, or -1 if the program could not
+         * be started.
+         */
         virtual bool postExecHook(const int systemRet) {
             (void)systemRet;
 
             return true;
         }
 
+        /* Run program through a util::ForkServer instead of system() */
+        virtual bool useForkServer(void) const {
+            return false;
+        }
+
     public:
+        /* Runs program through /bin/sh */
         BinaryExecutor(const std::string program) :
             program(program)
         { }
 
+        /* Runs argv[0], searched for in PATH, without a shell. env is
+         * added to the environment, replacing variables of the same name.
+         */
+        BinaryExecutor(const std::vector<std::string> argv, const Environment env = {}) :
+            argv(argv), env(env)
+        { }
+
+        virtual ~BinaryExecutor(void) = default;
+
         bool Run(void) {
+            status = ExitStatus();
+
             if ( preExecHook() == false ) {
                 return false;
             }
 
-            const auto systemRet = system(program.c_str());
+            const auto systemRet = execute();
+            if ( systemRet != -1 ) {
+                status = ExitStatus::FromWaitStatus(systemRet);
+            }
             const auto hookRet = postExecHook(systemRet);
-            
+
             if ( systemRet != 0 || hookRet == false ) {
                 return false;
             }
 
             return true;
         }
+
+        /* Status of the last Run() */
+        const ExitStatus& GetStatus(void) const {
+            return status;
+        }
 };
 
 } /* namespace util */
@@ -0,0 +1,360 @@
+#pragma once
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern char** environ;
+
+namespace fuzzing {
+namespace util {
+
+/* environ with env added, replacing variables of the same name, as
+ * NAME=value strings
+ */
+std::vector<std::string> MergeEnvironment(const std::vector<std::pair<std::string, std::string>>& env);
+
+/* AFL-style forkserver.
+ *
+ * The program is started once, with kControlFd and kStatusFd open and
+ * kForkServerEnv set. A target linked with the binaryexecutorcoverage
+ * client then stops before main and forks a fresh child for every Run().
+ *
+ * Protocol, all integers 4 bytes in host byte order:
+ *
+ *   client -> server: hello, once: kHelloArgs if it takes arguments
+ *   server -> client: run: kKeepArgs, or the size of the arguments
+ *                     followed by the arguments, each NUL-terminated
+ *   client -> server: child pid
+ *   client -> server: child wait status
+ *
+ * A run with arguments replaces argv[1..] of the child; argv[0] stays.
+ *
+ * A stopped child (persistent mode, see binaryexecutorcoverage/client.h)
+ * completed its run and is reported as a successful exit.
+ *
+ * Children inherit the environment and working directory the program was
+ * started with.
+ */
+class ForkServer {
+    private:
+        const std::vector<std::string> argv;
+        pid_t pid = -1;
+        int controlFd = -1;
+        int statusFd = -1;
+        bool supported = false;
+        bool supportsArgs = false;
+        /* wait(2) status of a run completed by the constructor, or -1 */
+        int exitStatus = -1;
+
+        bool readAll(void* data, const size_t size);
+        bool writeControl(const void* data, const size_t size);
+        bool run(const std::string& message, int& status);
+        void stop(void);
+    public:
+        static const int kControlFd = 198;
+        static const int kStatusFd = 199;
+        static constexpr const char* kForkServerEnv = "FUZZER_FORKSERVER";
+        static const uint32_t kHelloArgs = 1 << 0;
+        static const uint32_t kKeepArgs = UINT32_MAX;
+
+        /* Starts argv[0], searched for in PATH, with env added to the
+         * environment, and waits for the hello. If the target does not
+         * support the protocol it runs to completion, the server is not
+         * Alive(), and the run is left to TakeExitStatus().
+         */
+        ForkServer(const std::vector<std::string>& argv, const std::vector<std::pair<std::string, std::string>>& env = {});
+
+        /* Starts command through /bin/sh */
+        ForkServer(const std::string& command) :
+            ForkServer(std::vector<std::string>{"/bin/sh", "-c", command})
+        { }
+        ~ForkServer(void);
+
+        ForkServer(const ForkServer&) = delete;
+        ForkServer& operator=(const ForkServer&) = delete;
+
+        bool Alive(void) const {
+            return pid != -1;
+        }
+
+        /* Whether the target ever completed the hello */
+        bool Supported(void) const {
+            return supported;
+        }
+
+        /* Whether runs can have their own arguments */
+        bool SupportsArgs(void) const {
+            return supportsArgs;
+        }
+
+        /* If the target did not support the protocol and ran to
+         * completion in the constructor, takes its wait(2) status. The
+         * run then counts as the first run of argv. Returns false if the
+         * target could not be started, or the status was already taken.
+         */
+        bool TakeExitStatus(int& status) {
+            if ( exitStatus == -1 ) {
+                return false;
+            }
+            status = exitStatus;
+            exitStatus = -1;
+            return true;
+        }
+
+        /* argv the program was started with */
+        const std::vector<std::string>& Argv(void) const {
+            return argv;
+        }
+
+        /* Runs one child to completion with the arguments the program
+         * was started with. status is in wait(2) format. Returns false,
+         * and stops the server, on a protocol error.
+         */
+        bool Run(int& status);
+
+        /* As above, with args as argv[1..]. Returns false without
+         * running anything if !SupportsArgs().
+         */
+        bool Run(const std::vector<std::string>& args, int& status);
+};
+
+#ifndef FUZZING_HEADERS_NO_IMPL
+std::vector<std::string> MergeEnvironment(const std::vector<std::pair<std::string, std::string>>& env) {
+    std::vector<std::string> ret;
+
+    for (char** e = environ; *e != nullptr; e++) {
+        bool overridden = false;
+        for (const auto& var : env) {
+            if ( strncmp(*e, var.first.c_str(), var.first.size()) == 0 && (*e)[var.first.size()] == '=' ) {
+                overridden = true;
+                break;
+            }
+        }
+        if ( overridden == false ) {
+            ret.push_back(*e);
+        }
+    }
+    for (const auto& var : env) {
+        ret.push_back(var.first + "=" + var.second);
+    }
+
+    return ret;
+}
+
+ForkServer::ForkServer(const std::vector<std::string>& argv, const std::vector<std::pair<std::string, std::string>>& env) :
+    argv(argv)
+{
+    if ( argv.empty() ) {
+        return;
+    }
+
+    /* Not allocating after fork() */
+    std::vector<char*> args;
+    for (const auto& arg : argv) {
+        args.push_back(const_cast<char*>(arg.c_str()));
+    }
+    args.push_back(nullptr);
+
+    auto serverEnv = env;
+    serverEnv.emplace_back(kForkServerEnv, "1");
+    const auto vars = MergeEnvironment(serverEnv);
+    std::vector<char*> envp;
+    for (const auto& var : vars) {
+        envp.push_back(const_cast<char*>(var.c_str()));
+    }
+    envp.push_back(nullptr);
+
+    int control[2], status[2], error[2];
+
+    if ( pipe2(control, O_CLOEXEC) != 0 ) {
+        return;
+    }
+    if ( pipe2(status, O_CLOEXEC) != 0 ) {
+        close(control[0]);
+        close(control[1]);
+        return;
+    }
+    /* Receives errno if the program cannot be started */
+    if ( pipe2(error, O_CLOEXEC) != 0 ) {
+        close(control[0]);
+        close(control[1]);
+        close(status[0]);
+        close(status[1]);
+        return;
+    }
+
+    pid = fork();
+    if ( pid == 0 ) {
+        /* dup2 clears O_CLOEXEC on the new descriptors */
+        if ( dup2(control[0], kControlFd) != -1 && dup2(status[1], kStatusFd) != -1 ) {
+            /* Own process group, so the whole server can be killed */
+            setpgid(0, 0);
+            execvpe(args[0], args.data(), envp.data());
+        }
+        const int err = errno;
+        if ( write(error[1], &err, sizeof(err)) ) { }
+        _exit(127);
+    }
+
+    close(control[0]);
+    close(status[1]);
+    close(error[1]);
+
+    controlFd = control[1];
+    statusFd = status[0];
+
+    if ( pid == -1 ) {
+        close(error[0]);
+        stop();
+        return;
+    }
+
+    /* Closed by a successful exec */
+    int err;
+    const bool execFailed = read(error[0], &err, sizeof(err)) > 0;
+    close(error[0]);
+    if ( execFailed == true ) {
+        stop();
+        return;
+    }
+
+    uint32_t hello;
+    if ( readAll(&hello, sizeof(hello)) == false ) {
+        /* The program ran to completion without the protocol. That was
+         * a real run, so keep its result instead of running it again.
+         */
+        close(controlFd);
+        controlFd = -1;
+        close(statusFd);
+        statusFd = -1;
+        int status;
+        if ( waitpid(pid, &status, 0) == pid ) {
+            exitStatus = status;
+        }
+        pid = -1;
+        return;
+    }
+
+    supported = true;
+    supportsArgs = (hello & kHelloArgs) != 0;
+}
+
+ForkServer::~ForkServer(void) {
+    stop();
+}
+
+bool ForkServer::readAll(void* data, const size_t size) {
+    uint8_t* p = static_cast<uint8_t*>(data);
+    size_t left = size;
+
+    while ( left > 0 ) {
+        const auto ret = read(statusFd, p, left);
+        if ( ret <= 0 ) {
+            return false;
+        }
+        p += ret;
+        left -= ret;
+    }
+
+    return true;
+}
+
+/* A dead server must surface as a failed write. SIGPIPE is raised in
+ * the writing thread, so it is blocked there, and discarded if the write
+ * raised it, instead of changing its disposition for the whole process.
+ */
+bool ForkServer::writeControl(const void* data, const size_t size) {
+    sigset_t pipeSet, oldSet, pending;
+    sigemptyset(&pipeSet);
+    sigaddset(&pipeSet, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipeSet, &oldSet);
+
+    sigpending(&pending);
+    const bool wasPending = sigismember(&pending, SIGPIPE) == 1;
+
+    const bool ret = write(controlFd, data, size) == static_cast<ssize_t>(size);
+
+    if ( ret == false && errno == EPIPE && wasPending == false ) {
+        const struct timespec zero = {0, 0};
+        sigtimedwait(&pipeSet, nullptr, &zero);
+    }
+
+    pthread_sigmask(SIG_SETMASK, &oldSet, nullptr);
+
+    return ret;
+}
+
+void ForkServer::stop(void) {
+    if ( controlFd != -1 ) {
+        close(controlFd);
+        controlFd = -1;
+    }
+    if ( statusFd != -1 ) {
+        close(statusFd);
+        statusFd = -1;
+    }
+    if ( pid != -1 ) {
+        kill(-pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+        pid = -1;
+    }
+}
+
+bool ForkServer::Run(int& status) {
+    const uint32_t keep = kKeepArgs;
+    return run(std::string(reinterpret_cast<const char*>(&keep), sizeof(keep)), status);
+}
+
+bool ForkServer::Run(const std::vector<std::string>& args, int& status) {
+    if ( supportsArgs == false ) {
+        return false;
+    }
+
+    std::string message(sizeof(uint32_t), 0);
+    for (const auto& arg : args) {
+        message += arg;
+        message.push_back('\0');
+    }
+    const uint32_t size = message.size() - sizeof(size);
+    memcpy(&message[0], &size, sizeof(size));
+
+    return run(message, status);
+}
+
+bool ForkServer::run(const std::string& message, int& status) {
+    if ( Alive() == false ) {
+        return false;
+    }
+
+    if ( writeControl(message.data(), message.size()) == false ) {
+        stop();
+        return false;
+    }
+
+    int32_t childPid;
+    int32_t childStatus;
+    if ( readAll(&childPid, sizeof(childPid)) == false || readAll(&childStatus, sizeof(childStatus)) == false ) {
+        stop();
+        return false;
+    }
+
+    status = WIFSTOPPED(childStatus) ? 0 : childStatus;
+
+    return true;
+}
+#endif
+
+} /* namespace util */
+} /* namespace fuzzing */
@@ -2,24 +2,80 @@
 
 #include <optional>
 #include <random>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 
 namespace fuzzing {
 namespace util {
 
-#define PRNG std::minstd_rand0
-
-class Random : public PRNG {
+/* xoshiro256** (Blackman, Vigna). Satisfies UniformRandomBitGenerator.
+ * Without a seed, it is seeded from std::random_device and the clock.
+ */
+class Random {
  public:
-  Random(std::optional<uint32_t> seed = std::nullopt) : PRNG(seed ? *seed : 0 /* TODO time */) {}
-  result_type operator()() { return this->PRNG::operator()(); }
+  using result_type = uint64_t;
+
+  Random(std::optional<uint64_t> seed = std::nullopt) {
+      Seed(seed ? *seed : randomSeed());
+  }
+
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return UINT64_MAX; }
+
+  void Seed(uint64_t seed) {
+      /* Expand with splitmix64 so that similar seeds give unrelated
+       * streams and the state is never all zero.
+       */
+      for (auto& s : state) {
+          seed += 0x9E3779B97F4A7C15ULL;
+          uint64_t z = seed;
+          z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+          z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+          s = z ^ (z >> 31);
+      }
+      numBits = 0;
+  }
+
+  result_type operator()() {
+      const uint64_t ret = rotl(state[1] * 5, 7) * 9;
+      const uint64_t t = state[1] << 17;
+
+      state[2] ^= state[0];
+      state[3] ^= state[1];
+      state[1] ^= state[2];
+      state[0] ^= state[3];
+      state[2] ^= t;
+      state[3] = rotl(state[3], 45);
+
+      return ret;
+  }
+
   size_t Get(void) {
       return operator()();
   }
 
+  /* Uniform in [0, n), without modulo bias (Lemire) */
   size_t Get(size_t n) {
-      return n ? Get() % n : 0;
+      if ( n == 0 ) {
+          return 0;
+      }
+
+      uint64_t x = operator()();
+      __uint128_t m = static_cast<__uint128_t>(x) * n;
+      uint64_t l = static_cast<uint64_t>(m);
+      if ( l < n ) {
+          const uint64_t threshold = -static_cast<uint64_t>(n) % n;
+          while ( l < threshold ) {
+              x = operator()();
+              m = static_cast<__uint128_t>(x) * n;
+              l = static_cast<uint64_t>(m);
+          }
+      }
+
+      return m >> 64;
   }
 
   intptr_t Get(intptr_t From, intptr_t To) {
@@ -27,10 +83,54 @@ class Random : public PRNG {
       return Get(RangeSize) + From;
   }
 
-  size_t RandBool() { return Get() % 2; }
-};
+  /* One bit per call; a draw is only made every 64 calls */
+  size_t RandBool() {
+      if ( numBits == 0 ) {
+          bits = operator()();
+          numBits = 64;
+      }
+
+      const size_t ret = bits & 1;
+      bits >>= 1;
+      numBits--;
+
+      return ret;
+  }
 
-#undef PRNG
+  /* Fill data with size random bytes */
+  void Fill(void* data, size_t size) {
+      uint8_t* p = static_cast<uint8_t*>(data);
+
+      while ( size >= sizeof(uint64_t) ) {
+          const uint64_t v = operator()();
+          memcpy(p, &v, sizeof(v));
+          p += sizeof(v);
+          size -= sizeof(v);
+      }
+
+      if ( size ) {
+          const uint64_t v = operator()();
+          memcpy(p, &v, size);
+      }
+  }
+
+ private:
+  uint64_t state[4];
+  uint64_t bits = 0;
+  size_t numBits = 0;
+
+  static uint64_t rotl(const uint64_t x, const int k) {
+      return (x << k) | (x >> (64 - k));
+  }
+
+  static uint64_t randomSeed(void) {
+      std::random_device rd;
+      const uint64_t hi = rd();
+      const uint64_t lo = rd();
+      const uint64_t t = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+      return ((hi << 32) | lo) ^ t;
+  }
+};
 
 } /* namespace util */
 } /* namespace fuzzing */
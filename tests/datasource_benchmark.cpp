@@ -0,0 +1,120 @@
+#include <fuzzing/datasource/datasource.hpp>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+/* Measures the per-read cost of Get<T> for the virtual and the
+ * statically dispatched datasource, and for the datasource as it was
+ * before either (one std::vector per read).
+ *
+ * g++ -std=c++17 -O2 -Iinclude tests/datasource_benchmark.cpp
+ */
+
+using fuzzing::datasource::Datasource;
+using fuzzing::datasource::StaticDatasource;
+
+/* Reads like the original Datasource: every read returns a std::vector
+ * through the virtual get().
+ */
+class VectorDatasource : public fuzzing::datasource::Base
+{
+    private:
+        const uint8_t* data;
+        size_t left;
+
+        std::vector<uint8_t> get(const size_t min, const size_t max, const uint64_t id) override {
+            (void)id;
+
+            uint32_t getSize;
+            if ( left < sizeof(getSize) ) {
+                throw OutOfData();
+            }
+            memcpy(&getSize, data, sizeof(getSize));
+            data += sizeof(getSize);
+            left -= sizeof(getSize);
+
+            if ( getSize < min ) {
+                getSize = min;
+            }
+            if ( max && getSize > max ) {
+                getSize = max;
+            }
+            if ( left < getSize ) {
+                throw OutOfData();
+            }
+
+            std::vector<uint8_t> ret(data, data + getSize);
+            data += getSize;
+            left -= getSize;
+
+            return ret;
+        }
+    public:
+        VectorDatasource(const uint8_t* _data, const size_t _size, const uint32_t _format) :
+            data(_data), left(_size)
+        {
+            (void)_format;
+        }
+};
+
+static const size_t kNumReads = 1 << 12;
+static const size_t kRounds = 1 << 14;
+
+template <class DatasourceType>
+static __attribute__((noinline)) uint64_t readAll(DatasourceType& ds) {
+    uint64_t ret = 0;
+    try {
+        while ( true ) {
+            ret += ds.template Get<uint32_t>();
+            ret += ds.template Get<bool>();
+        }
+    } catch ( const fuzzing::datasource::OutOfData& ) { }
+    return ret;
+}
+
+template <class DatasourceType>
+static void bench(const char* name, const std::vector<uint8_t>& input, const uint32_t format) {
+    uint64_t sum = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kRounds; i++) {
+        DatasourceType ds(input.data(), input.size(), format);
+        sum += readAll(ds);
+    }
+    const auto end = std::chrono::steady_clock::now();
+    const double ns = std::chrono::duration<double, std::nano>(end - start).count();
+
+    printf("%-40s %6.2f ns/read (checksum %llu)\n", name, ns / (kRounds * kNumReads * 2), (unsigned long long)sum);
+}
+
+static std::vector<uint8_t> makeInput(const bool rawScalars) {
+    std::vector<uint8_t> ret;
+    for (size_t i = 0; i < kNumReads; i++) {
+        const uint32_t v = i;
+        const uint32_t b = i & 1;
+        if ( rawScalars == false ) {
+            const uint32_t size = sizeof(v);
+            ret.insert(ret.end(), (const uint8_t*)&size, (const uint8_t*)&size + sizeof(size));
+        }
+        ret.insert(ret.end(), (const uint8_t*)&v, (const uint8_t*)&v + sizeof(v));
+        if ( rawScalars == false ) {
+            const uint32_t size = 1;
+            ret.insert(ret.end(), (const uint8_t*)&size, (const uint8_t*)&size + sizeof(size));
+        }
+        ret.push_back(b);
+    }
+    return ret;
+}
+
+int main(void)
+{
+    const auto prefixed = makeInput(false);
+    const auto raw = makeInput(true);
+
+    bench<VectorDatasource>("Before: std::vector per read", prefixed, fuzzing::datasource::FormatDefault);
+    bench<Datasource>("Datasource", prefixed, fuzzing::datasource::FormatDefault);
+    bench<StaticDatasource>("StaticDatasource", prefixed, fuzzing::datasource::FormatDefault);
+    bench<Datasource>("Datasource (FormatRawScalars)", raw, fuzzing::datasource::FormatRawScalars);
+    bench<StaticDatasource>("StaticDatasource (FormatRawScalars)", raw, fuzzing::datasource::FormatRawScalars);
+
+    return 0;
+}
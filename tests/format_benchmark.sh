@@ -0,0 +1,32 @@
+#!/bin/bash
+
+# Compares the fixed and the varint length prefix formats on a JSON harness.
+#
+# Usage: tests/format_benchmark.sh <nlohmann|rapidjson> [seconds per run]
+#
+# Needs clang with libFuzzer. Pass the include path of the JSON library
+# through CXXFLAGS.
+
+set -e
+
+HARNESS=${1:-nlohmann}
+MAX_TOTAL_TIME=${2:-300}
+CXX=${CXX:-clang++}
+
+for FORMAT in FormatDefault FormatVarintLength; do
+    BINARY=$HARNESS-$FORMAT
+    CORPUS=corpus-$HARNESS-$FORMAT
+
+    $CXX -std=c++17 -O2 -fsanitize=fuzzer -Iinclude $CXXFLAGS \
+        -DFUZZING_DATASOURCE_FORMAT=fuzzing::datasource::$FORMAT \
+        tests/$HARNESS.cpp -o $BINARY
+
+    rm -rf $CORPUS
+    mkdir $CORPUS
+    ./$BINARY -max_total_time=$MAX_TOTAL_TIME -print_final_stats=1 $CORPUS 2>$BINARY.log || true
+
+    echo "$FORMAT:"
+    echo "    corpus files: $(ls $CORPUS | wc -l)"
+    echo "    corpus bytes: $(cat $CORPUS/* 2>/dev/null | wc -c)"
+    grep -E "stat::(average_exec_per_sec|number_of_executed_units)" $BINARY.log | sed 's/^/    /'
+done
@@ -160,9 +160,14 @@ extern "C" int LLVMFuzzerInitialize(int *_argc, char ***_argv) {
     return 0;
 }
 
+/* E.g. -DFUZZING_DATASOURCE_FORMAT=fuzzing::datasource::FormatPartitioned */
+#ifndef FUZZING_DATASOURCE_FORMAT
+#define FUZZING_DATASOURCE_FORMAT fuzzing::datasource::FormatDefault
+#endif
+
 extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
 {
-    fuzzing::datasource::Datasource ds(data, size);
+    fuzzing::datasource::Datasource ds(data, size, FUZZING_DATASOURCE_FORMAT);
 
     try {
         jsonTester->Test(ds);